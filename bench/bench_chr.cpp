@@ -0,0 +1,54 @@
+// Microbenchmark of the pattern table decoding kernels (chr.hpp): decode the
+// 512 tiles of 8KB of random CHR over and over, and check each kernel
+// against the reference.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "chr.hpp"
+
+static constexpr uint32_t kTiles = 512;
+static constexpr uint32_t kRounds = 20000;
+
+static Byte chr[kTiles * 16];
+static Byte out[kTiles * 64];
+static Byte ref[kTiles * 64];
+
+template <void (*kernel)(const Byte *, Byte *)>
+static void run(const char *name) {
+    for (uint32_t t = 0; t < kTiles; t++)
+        kernel(chr + t * 16, out + t * 64);
+    if (std::memcmp(out, ref, sizeof(ref)) != 0) {
+        std::printf("%-8s MISMATCH\n", name);
+        return;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < kRounds; r++) {
+        for (uint32_t t = 0; t < kTiles; t++)
+            kernel(chr + t * 16, out + t * 64);
+        // keep the stores alive
+        asm volatile("" : : "r"(out) : "memory");
+    }
+    const double dt = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+    std::printf("%-8s %6.2f ns/tile\n", name, dt * 1e9 / kRounds / kTiles);
+}
+
+int main() {
+    std::mt19937 rng(0);
+    for (Byte &b : chr)
+        b = rng();
+    for (uint32_t t = 0; t < kTiles; t++)
+        Chr::decode_tile_bits(chr + t * 16, ref + t * 64);
+
+    run<Chr::decode_tile_bits>("bits");
+    run<Chr::decode_tile_scalar>("scalar");
+#if defined(__SSE2__)
+    run<Chr::decode_tile_sse2>("sse2");
+#endif
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Benchmark of the savestates (savestate.hpp): snapshot and restore a running
+// console over and over, then check that a restored console runs the same
+// frames as the original one. Then, the cost of recording a rewind history
+// (rewind.hpp) for a minute of play.
+//
+// Usage: NEBenchState [rom] [interval]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "nes.hpp"
+#include "rewind.hpp"
+
+static constexpr uint32_t kRounds = 100000;
+static constexpr uint32_t kFrames = 60;
+
+// rewind: ring size, and frames recorded
+static constexpr size_t kRing = 4 * 1024 * 1024;
+static constexpr uint32_t kRewindFrames = 3600;
+
+// seconds per call of `fn`, over `kRounds` calls
+template <typename F> static double time_per_call(F fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < kRounds; r++) {
+        fn();
+        // keep the copies alive
+        asm volatile("" : : : "memory");
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         t0)
+               .count() /
+           kRounds;
+}
+
+int main(int argc, char **argv) {
+    auto nes = std::make_unique<NES>();
+    nes->Load(argc > 1 ? argv[1] : "./data/nestest.nes");
+    for (uint32_t i = 0; i < kFrames; i++)
+        nes->RunFrame();
+
+    auto state = std::make_unique<SaveState>();
+    const double save = time_per_call([&]() { nes->Save(*state); });
+    const double load = time_per_call([&]() { nes->Load(*state); });
+    const double both = time_per_call([&]() {
+        nes->Save(*state);
+        nes->Load(*state);
+    });
+    std::printf("state    %zu bytes\n", sizeof(SaveState));
+    std::printf("save     %6.2f us\n", save * 1e6);
+    std::printf("load     %6.2f us\n", load * 1e6);
+    std::printf("both     %6.2f us\n", both * 1e6);
+
+    // the frames after a restore are the frames after the snapshot
+    nes->Save(*state);
+    for (uint32_t i = 0; i < kFrames; i++)
+        nes->RunFrame();
+    const std::vector<uint32_t> frame(std::begin(nes->ppu.frame),
+                                      std::end(nes->ppu.frame));
+    nes->Load(*state);
+    for (uint32_t i = 0; i < kFrames; i++)
+        nes->RunFrame();
+    const bool same = std::equal(frame.begin(), frame.end(), nes->ppu.frame);
+    std::printf("replay   %s\n", same ? "OK" : "MISMATCH");
+
+    const uint32_t interval = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1;
+    Rewind rewind(kRing, interval ? interval : 1);
+    for (uint32_t i = 0; i < kRewindFrames; i++) {
+        nes->RunFrame();
+        rewind.Push(*nes);
+    }
+    // history the whole ring would hold, at the average size of a delta
+    const double delta = (double)rewind.Used() / (rewind.Count() - 1);
+    const double history = kRing / delta * rewind.interval / 60.0988;
+    std::printf("rewind   every %u frames, %zu snapshots in %zu bytes\n",
+                rewind.interval, rewind.Count(), rewind.Used());
+    std::printf("delta    %6.1f bytes (%.1fx smaller), %.0f s of history in "
+                "%zu MB\n",
+                delta, sizeof(SaveState) / delta, history, kRing >> 20);
+    std::printf("push     %6.2f us average, %.2f us max, %.2f us per frame\n",
+                rewind.push_time / rewind.pushed * 1e6,
+                rewind.push_time_max * 1e6,
+                rewind.push_time / kRewindFrames * 1e6);
+    return same ? 0 : 1;
+}
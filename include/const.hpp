@@ -12,10 +12,15 @@ using Mem = std::vector<Byte>;
 using RegB = uint8_t;  // byte-sized register
 using RegW = uint16_t; // word-sized register
 
-// Memory size of the main RAM (~16KB)
-static constexpr uint32_t kRAMSize = 0x4020;
+// Memory size of the internal RAM (2KB, mirrored up to 0x1FFF)
+static constexpr uint32_t kRAMSize = 0x0800;
 static constexpr uint32_t kVRAMSize = 4 * 1024;
 static constexpr uint32_t kPaletteSize = 32;
+static constexpr uint32_t kOAMSize = 256;
+
+// Size of the picture, in pixels
+static constexpr uint16_t kScreenW = 256;
+static constexpr uint16_t kScreenH = 240;
 
 // Master Palette:
 //
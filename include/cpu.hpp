@@ -111,6 +111,40 @@ enum class Instruct : uint8_t {
 
 struct CPU {
 
+    // fused opcode handler, see `CPU::Step`
+    using OpFunc = void (*)(CPU &);
+
+    // A decoded instruction, cached per PC of an 8KB bank of PRG-ROM.
+    //
+    // Zero-initialized entries are not decoded yet. Being keyed by the bank,
+    // and not by the slot it is mapped to, an entry stays valid across bank
+    // switches.
+    struct Decoded {
+        Byte opcode;    // index of the fused handler in `map_func_exec`
+        Byte lhs;       // 1st operand byte
+        Byte rhs;       // 2nd operand byte
+        uint8_t len;    // length of the instruction in bytes; 0: not decoded
+        uint8_t cycles; // base cycles
+        // whether it can be served from the cache, i.e. it does not run across
+        // two 8KB slots, and lives in PRG-ROM at all
+        bool ok;
+        // number of instructions of the straight-line block starting here,
+        // see `CPU::RunBlock`; `kBlockNone`: not translated yet
+        uint8_t blen;
+        // for branches: cycles per iteration of the idle loop they close, see
+        // `CPU::IdleCycles`; 0: not an idle loop; `kIdleNone`: not analyzed
+        uint8_t idle;
+    };
+
+    // `Decoded::blen` of instructions not translated into a block yet
+    static constexpr uint8_t kBlockNone = 0xFF;
+    // maximum number of instructions in a block
+    static constexpr uint8_t kBlockMax = 32;
+    // `Decoded::idle` of branches not analyzed yet
+    static constexpr uint8_t kIdleNone = 0xFF;
+    // maximum size of the body of an idle loop, in bytes
+    static constexpr uint8_t kIdleMax = 16;
+
     // implement flag register as a union of 1 byte and 1 struct
     union RegF {
 
@@ -127,12 +161,19 @@ struct CPU {
             uint8_t V : 1; // Overflow
             uint8_t N : 1; // Negative
         };
+    };
 
-        // set the negative flag
-        inline void SetN(const Byte &f) { N = (f & (1 << 7)) != 0; }
-
-        // set the zero flag
-        inline void SetZ(const Byte &f) { Z = f == 0x00; }
+    // Lazily evaluated flags.
+    //
+    // ALU instructions only record the raw values the N, Z, C, V flags derive
+    // from, instead of read-modify-writing the bits of `RF`. The flag register
+    // is materialized by `SyncF` whenever it is read as a whole, i.e. pushed to
+    // the stack or printed. I, D, B, U are still kept in `RF` directly.
+    struct LazyF {
+        Byte n; // N: bit 7
+        Byte z; // Z: set if 0
+        Byte c; // C: 0 or 1
+        Byte v; // V: bit 7
     };
 
     // Initial stack pointer value
@@ -141,14 +182,15 @@ struct CPU {
     // Registers
     // store results and the program control flow
     RegW PC; // Program counter
-    RegF RF; // Flag register
+    RegF RF; // Flag register, N / Z / C / V are only valid after `SyncF`
+    LazyF LF; // Lazy flags
     RegB RA; // Accumulator
     RegB RX; // X index
     RegB RY; // Y index
     RegB SP; // Stack pointer
 
     // clock cycles for synchronization
-    uint8_t cycles;
+    uint16_t cycles;
 
     // Temporary Registers
     // store the fetched data and addressess
@@ -159,12 +201,30 @@ struct CPU {
     // storage
     Disk *disk;
 
+    // decoded instructions of each 8KB bank of PRG-ROM of `irom`, allocated
+    // the first time the bank runs code, indexed by `PC & 0x1FFF`. The last
+    // one stands for a slot without PRG-ROM, and is never decoded.
+    std::shared_ptr<const Rom> irom;
+    std::vector<std::unique_ptr<Decoded[]>> ibank;
+    // decoded instructions of the bank mapped to each slot of the PRG window,
+    // as of the `Disk::prg_rev` of the slot in `irev`
+    Decoded *islot[4];
+    uint32_t irev[4];
+
+    // run straight-line blocks of PRG code at once, see `CPU::RunBlock`
+    bool blocks;
+
+    // detect idle loops so that the scheduler can skip them, see
+    // `CPU::IdleCycles`. Can be turned off for ROMs it does not work with.
+    bool idle_skip;
+
     // Initial program counter value
     size_t cyc_count;
 
     // ---------- logging ----------
 
     uint16_t addr; // address of the current instruction opcode
+    uint8_t opcode;
     AddrMode mode;
     Instruct instr;
     uint8_t n_param;
@@ -181,6 +241,27 @@ struct CPU {
     // attach memory to the CPU
     void Mount(const Disk &disk);
 
+    // ---------- Flags ----------
+
+    // set N and Z flags from the result of an operation
+    inline void SetNZ(const Byte &f) { LF.n = LF.z = f; }
+
+    // materialize the flag register from the lazy flags
+    inline RegF &SyncF() {
+        RF.reg = (RF.reg & 0b00111100) | (LF.n & 0x80) | ((LF.v & 0x80) >> 1) |
+                 ((LF.z == 0) << 1) | (LF.c & 0x01);
+        return RF;
+    }
+
+    // load the whole flag register, e.g. when pulled from the stack
+    inline void LoadF(const Byte &f) {
+        RF.reg = f;
+        LF.n = f;
+        LF.z = ~f & 0x02;
+        LF.c = f & 0x01;
+        LF.v = f << 1;
+    }
+
     // ---------- Reset / Interrupt ----------
 
     void Reset();
@@ -286,6 +367,14 @@ struct CPU {
 
     void RunInstr();
 
+    void Step();
+
+    // run a block of at most `budget` cycles, give or take the last
+    // instruction
+    void RunBlock(const uint32_t &budget = UINT32_MAX);
+
+    uint8_t IdleCycles();
+
     void Print();
 
     void BinToAsm(const Mem &, std::vector<std::string> &);
@@ -5,13 +5,27 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+
 #include "const.hpp"
+#include "mapper.hpp"
+#include "rom.hpp"
 
 enum class MirrorMode : uint8_t {
-    SINGLE = 0,
+    SINGLE = 0, // one-screen, lower bank
     HORIZ,
     VERT,
     FOUR,
+    SINGLE_HI, // one-screen, upper bank
+};
+
+// Handlers of the pages of the main bus that are not backed by memory
+enum class PageIO : uint8_t {
+    NONE = 0, // open bus, writes are ignored
+    PPU,      // 0x2000 - 0x3FFF, PPU registers
+    APU,      // 0x4000 - 0x40FF, APU and I/O registers, OAMDMA
+    MAPPER,   // 0x8000 - 0xFFFF (writes), mapper registers
 };
 
 // PPU Registers (0x2000 - 0x2007, 0x4014, loopy's).
@@ -264,18 +278,111 @@ struct PMem {
     inline uint16_t AddrInc() { return ctrl.inc ? 32 : 1; }
 };
 
+// Object Attribute Memory: 64 sprites of 4 bytes, as seen through OAMADDR /
+// OAMDATA (byte 0: Y, 1: tile, 2: attributes, 3: X), stored one array per
+// byte so that a scanline tests the Y of all the sprites at once.
+//
+//   Attributes:
+//
+//   76543210
+//   --------
+//   VHP...PP
+//   |||   ||
+//   |||   ++- Palette of the sprite (4 - 7)
+//   ||+------ Priority (0: in front of background; 1: behind background)
+//   |+------- Flip sprite horizontally
+//   +-------- Flip sprite vertically
+//
+// References:
+//
+// - https://www.nesdev.org/wiki/PPU_OAM
+struct OAM {
+    alignas(64) Byte y[64];
+    alignas(64) Byte tile[64];
+    alignas(64) Byte attr[64];
+    alignas(64) Byte x[64];
+
+    // Read 1 byte at `addr` (0x00 - 0xFF)
+    inline Byte Read(const uint8_t &addr) const {
+        switch (addr & 0x03) {
+        case 0:
+            return y[addr >> 2];
+        case 1:
+            return tile[addr >> 2];
+        case 2:
+            return attr[addr >> 2];
+        default:
+            return x[addr >> 2];
+        }
+    }
+
+    // Load all the 256 bytes, in the order of OAMADDR from 0
+    inline void Load(const Byte *mem) {
+        for (uint8_t i = 0; i < 64; i++) {
+            y[i] = mem[i * 4];
+            tile[i] = mem[i * 4 + 1];
+            attr[i] = mem[i * 4 + 2] & 0xE3;
+            x[i] = mem[i * 4 + 3];
+        }
+    }
+
+    // Write 1 byte at `addr` (0x00 - 0xFF)
+    inline void Write(const uint8_t &addr, const Byte &data) {
+        switch (addr & 0x03) {
+        case 0:
+            y[addr >> 2] = data;
+            break;
+        case 1:
+            tile[addr >> 2] = data;
+            break;
+        case 2:
+            // bits 2 - 4 do not exist
+            attr[addr >> 2] = data & 0xE3;
+            break;
+        default:
+            x[addr >> 2] = data;
+            break;
+        }
+    }
+};
+
 // Collection of Memory
 struct Disk {
 
     // ------------------------------------------------------------------------
     // Array-like storage
+    //
+    // The memory of the console has a fixed size and lives in the instance,
+    // each region on its own cache lines. The ROM of the cartridge is shared
+    // read-only (see `Rom`), only its RAM is allocated per instance.
     // ------------------------------------------------------------------------
 
-    Mem ram; // 8KB internal RAM + 8KB PPU registers + 32B APU & I/O registers
-    Mem vrm; // NT * 4 + AT * 4 (4KB)
-    Mem pal; // palette (32B)
-    Mem prg; // max: 32KB. TODO: expand
-    Mem chr; // max: 8KB. TODO: expand
+    alignas(64) Byte ram[kRAMSize];     // 2KB internal RAM
+    alignas(64) Byte vrm[kVRAMSize];    // NT * 4 + AT * 4 (4KB)
+    alignas(64) Byte pal[kPaletteSize]; // palette (32B)
+    OAM oam;                            // sprite attributes (256B)
+
+    std::shared_ptr<const Rom> rom;
+    Mem banks; // PRG-RAM (8KB), followed by CHR-RAM (8KB) and its tiles if any
+    const Byte *prg; // PRG-ROM
+    const Byte *chr; // CHR-ROM, or CHR-RAM
+    Byte *prg_ram;
+    Byte *chr_ram; // nullptr: CHR-ROM, writes are dropped
+
+    // 1KB CHR banks of the pattern tables (0x0000 - 0x1FFF), see `MapCHR`
+    const Byte *chr_rd[8];
+    Byte *chr_wr[8]; // nullptr: CHR-ROM, writes are dropped
+
+    // Decoded tiles of `chr`, the two bit planes of each row merged into one
+    // pixel (0 - 3) per byte, leftmost first, 64 bytes per tile. CHR-ROM is
+    // decoded once in `Rom`; CHR-RAM tiles are decoded into `banks` on first
+    // use, and dropped when written, see `ReadTileRow`.
+    const Byte *tiles;
+    Byte *tiles_ram; // nullptr: CHR-ROM, all decoded
+    Byte *tile_ok;   // CHR-RAM tiles decoded since last written
+
+    // the decoded tiles of the 1KB CHR banks of `chr_rd`
+    const Byte *tile_rd[8];
 
     // ------------------------------------------------------------------------
     // PPU related
@@ -289,6 +396,18 @@ struct Disk {
     // PPU registers
     PMem pram;
 
+    // The palette, or the PPUMASK bits changing its colors (greyscale,
+    // emphasis), changed since the PPU last resolved it, see `PPU::colors`
+    bool pal_dirty;
+
+    // Called right before the CPU accesses the PPU registers (0x2000 - 0x3FFF,
+    // 0x4014), so that a PPU running behind the CPU can catch up first.
+    std::function<void()> sync;
+
+    // An OAM DMA copied a page into OAM, and the CPU still owes the cycles it
+    // is halted for; the scheduler charges them after the instruction.
+    bool oam_dma;
+
     // ------------------------------------------------------------------------
     // Cartridge related
     // ------------------------------------------------------------------------
@@ -296,6 +415,30 @@ struct Disk {
     uint16_t prg_kb;
     uint16_t chr_kb;
     MirrorMode mirror;
+    Mapper mapper;
+
+    // 1KB of VRAM behind each logical nametable (0x2000, 0x2400, 0x2800,
+    // 0x2C00) as per `mirror`, see `MapNT`
+    Byte *nt[4];
+
+    // Revision of each 8KB slot of the PRG window (0x8000 - 0xFFFF), bumped
+    // whenever the slot gets remapped. Anything derived from the contents of
+    // the slot (e.g. the decoded instructions looked up for it) is stale once
+    // the revision changes.
+    uint32_t prg_rev[4];
+
+    // ------------------------------------------------------------------------
+    // Page table of the main bus: 256 pages of 256 bytes
+    //
+    // A page is either backed by host memory (RAM and its mirrors, PRG-ROM),
+    // or handled by `PageIO` when its pointer is null. Banks and mirrors are
+    // mapped by repointing pages, see `MapMBus`, so that a plain access is a
+    // lookup and a load whatever the memory behind it.
+    // ------------------------------------------------------------------------
+
+    const Byte *page_rd[256];
+    Byte *page_wr[256];
+    PageIO page_io[256];
 
     // ------------------------------------------------------------------------
     // Methods
@@ -306,6 +449,10 @@ struct Disk {
     Disk();
     ~Disk();
 
+    // the page table points into the instance
+    Disk(const Disk &) = delete;
+    Disk &operator=(const Disk &) = delete;
+
     // print disk info
     void Print();
 
@@ -315,10 +462,32 @@ struct Disk {
     // ---------- Read / Write via Main Bus ----------
 
     // Read 1 byte via the main bus
-    Byte ReadMBus(const uint16_t &);
+    inline Byte ReadMBus(const uint16_t &addr) {
+        const Byte *page = page_rd[addr >> 8];
+        return page ? page[addr & 0xFF] : ReadIO(addr);
+    }
 
     // Write 1 byte via the main bus
-    void WriteMBus(const uint16_t &, const Byte &);
+    inline void WriteMBus(const uint16_t &addr, const Byte &data) {
+        Byte *page = page_wr[addr >> 8];
+        if (page)
+            page[addr & 0xFF] = data;
+        else
+            WriteIO(addr, data);
+    }
+
+    void MapMBus(const uint8_t &, const uint16_t &, const Byte *, Byte *,
+                 const uint32_t &, const PageIO & = PageIO::NONE);
+
+    void MapPRG(const uint8_t &, const uint32_t &);
+
+    void MapMBus(const uint8_t &, const uint16_t &, const PageIO &);
+
+    Byte ReadIO(const uint16_t &);
+
+    void OAMDMA(const Byte &);
+
+    void WriteIO(const uint16_t &, const Byte &);
 
     Byte ReadPRam(const uint16_t &);
 
@@ -326,9 +495,37 @@ struct Disk {
 
     // ---------- Read / Write via the PPU Bus ----------
 
+    void MapNT(const MirrorMode &);
+
+    void MapCHR(const uint8_t &, const uint32_t &);
+
+    // Read 1 byte from the nametables (0x2000 - 0x3EFF)
+    inline Byte ReadNT(const uint16_t &addr) const {
+        return nt[(addr >> 10) & 0x03][addr & 0x03FF];
+    }
+
+    // Write 1 byte to the nametables (0x2000 - 0x3EFF)
+    inline void WriteNT(const uint16_t &addr, const Byte &data) {
+        nt[(addr >> 10) & 0x03][addr & 0x03FF] = data;
+    }
+
     // Read 1 byte via the PPU bus
     Byte ReadPBus(const uint16_t &);
 
+    // Read the 8 pixels of a tile row, `addr` being the address of its low
+    // bit plane (0x0000 - 0x1FFF)
+    inline const Byte *ReadTileRow(const uint16_t &addr) {
+        const uint8_t slot = (addr >> 10) & 0x07;
+        if (tiles_ram) {
+            const uint16_t tile = (chr_rd[slot] - chr + (addr & 0x03FF)) >> 4;
+            if (!tile_ok[tile])
+                DecodeTile(tile);
+        }
+        return tile_rd[slot] + ((addr & 0x03F0) << 2) + ((addr & 0x07) << 3);
+    }
+
+    void DecodeTile(const uint16_t &);
+
     // Write 1 byte via the PPU bus
     void WritePBus(const uint16_t &, const Byte &);
 };
@@ -0,0 +1,88 @@
+// ============================================================================
+// SFML frontend: a window presenting the frames of the console
+//
+// The console itself (nes.hpp) knows nothing about SFML; this is the only
+// part of the emulator that does.
+//
+// Emulation and presentation run on their own threads, so that neither a
+// slow present nor a slow frame stalls the other:
+//
+// - the emulation thread runs the console at the pace of its `Pacer`, and
+//   publishes each frame through a triple buffer;
+// - the calling thread owns the window: it polls its events, forwarding them
+//   to the emulation thread through a queue, and presents the newest frame
+//   published, if any.
+//
+// Keys: 1 realtime, 2 2x, 3 4x, 4 0.5x, 0 uncapped (present the newest frame
+// only), Backspace (held) rewind. The window title shows the frame rate
+// reached.
+// ============================================================================
+
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <atomic>
+
+#include "nes.hpp"
+#include "pacer.hpp"
+#include "rewind.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
+
+// Frame of the PPU, see `PPU::frame`
+struct Frame {
+    alignas(64) uint32_t px[kScreenW * kScreenH];
+};
+
+// Input of the window, for the emulation thread
+enum class InputEvent : uint8_t {
+    // reset the console
+    RESET = 0,
+    // stop the emulation thread
+    QUIT,
+    // speed of the emulation, see `Pacer`
+    SPEED_REALTIME,
+    SPEED_2X,
+    SPEED_4X,
+    SPEED_HALF,
+    SPEED_UNCAPPED,
+    // go back in time, until stopped, see `Rewind`
+    REWIND_START,
+    REWIND_STOP,
+};
+
+struct Frontend {
+    NES nes;
+    sf::RenderWindow window;
+
+    // frames, from the emulation thread to the window
+    TripleBuffer<Frame> frames;
+    // events, from the window to the emulation thread
+    SpscQueue<InputEvent, 64> events;
+
+    // pace of the emulation thread, and the frame rate it reached over the
+    // last second
+    Pacer pacer;
+    std::atomic<double> fps;
+
+    // history of the emulation thread, and whether it is going back in it
+    Rewind rewind;
+    bool rewinding;
+
+    // Constructor
+    Frontend();
+    // Destructor
+    ~Frontend();
+
+    // Run and present frames until the window gets closed
+    void Run();
+
+  private:
+    // the emulation thread
+    void emulate();
+
+    void send(const InputEvent &);
+    void key_pressed(const sf::Keyboard::Key &);
+    void key_released(const sf::Keyboard::Key &);
+    void show_fps();
+};
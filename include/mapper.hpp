@@ -0,0 +1,127 @@
+// ============================================================================
+// Cartridge mappers
+//
+// A mapper only reacts to writes to its registers, by repointing the banks of
+// the disk (`Disk::MapPRG`, `Disk::MapCHR`, `Disk::MapNT`). Reads never go
+// through it, so the read path is the same whatever the mapper.
+//
+// References:
+//
+// - https://www.nesdev.org/wiki/Mapper
+// ============================================================================
+
+#pragma once
+
+#include "const.hpp"
+
+struct Disk;
+
+// iNES mapper numbers of the supported mappers
+enum class MapperId : uint8_t {
+    NROM = 0,
+    MMC1 = 1,
+    UXROM = 2,
+    CNROM = 3,
+    MMC3 = 4,
+    AXROM = 7,
+};
+
+struct Mapper {
+
+    MapperId id;
+
+    // ------------------------------------------------------------------------
+    // MMC1 (SxROM)
+    //
+    // Registers are written serially, 1 bit at a time through a 5-bit shift
+    // register. The 5th write copies it into the register selected by the
+    // address: 0x8000 control, 0xA000 CHR bank 0, 0xC000 CHR bank 1, 0xE000
+    // PRG bank.
+    //
+    //   Control:
+    //
+    //   4bit0
+    //   -----
+    //   CPPMM
+    //   |||||
+    //   |||++- Mirroring (0: one-screen, lower bank; 1: one-screen, upper bank;
+    //   |||               2: vertical; 3: horizontal)
+    //   |++--- PRG-ROM bank mode (0, 1: switch 32 KB at $8000, ignoring low bit
+    //   |                         of bank number;
+    //   |                         2: fix first bank at $8000 and switch 16 KB
+    //   |                         bank at $C000;
+    //   |                         3: fix last bank at $C000 and switch 16 KB
+    //   |                         bank at $8000)
+    //   +----- CHR-ROM bank mode (0: switch 8 KB at a time;
+    //                             1: switch two separate 4 KB banks)
+    // ------------------------------------------------------------------------
+
+    uint8_t shift;   // shift register
+    uint8_t n_shift; // number of bits written into the shift register
+    uint8_t control;
+    uint8_t chr0;
+    uint8_t chr1;
+    uint8_t prg;
+
+    // ------------------------------------------------------------------------
+    // MMC3 (TxROM)
+    //
+    // 0x8000 (even) selects which of the 8 bank registers 0x8001 (odd) writes,
+    // along with the PRG / CHR bank modes:
+    //
+    //   7  bit  0
+    //   ---- ----
+    //   CPxx xRRR
+    //   ||     |||
+    //   ||     +++- Bank register to update on next write to 0x8001
+    //   ||          (0-1: 2 KB CHR; 2-5: 1 KB CHR; 6-7: 8 KB PRG)
+    //   |+--------- PRG-ROM bank mode (0: $8000-$9FFF swappable, $C000-$DFFF
+    //   |           fixed to second-last bank; 1: swapped)
+    //   +---------- CHR A12 inversion (0: two 2 KB banks at $0000-$0FFF, four
+    //               1 KB banks at $1000-$1FFF; 1: swapped)
+    // ------------------------------------------------------------------------
+
+    uint8_t select;
+    uint8_t bank[8];
+
+    // Scanline IRQ: the counter is clocked once per rendered scanline (dot
+    // 260, when the PPU fetches sprite patterns from 0x1000), reloaded from
+    // the latch when it is 0 or a reload was requested, and asserts the IRQ
+    // line when it reaches 0.
+    uint8_t irq_latch;
+    uint8_t irq_counter;
+    bool irq_reload;
+    bool irq_enable;
+
+    // IRQ line, asserted until acknowledged
+    bool irq;
+
+    // ---------- Constructor & Destructor ----------
+
+    Mapper();
+    ~Mapper();
+
+    // ---------- Methods ----------
+
+    // whether the mapper is supported
+    static bool Supported(const uint8_t &);
+
+    // power-up state of the mapper and its banks
+    void Reset(Disk &);
+
+    // write to the registers of the mapper (0x8000 - 0xFFFF)
+    void Write(Disk &, const uint16_t &, const Byte &);
+
+    // clock the scanline counter
+    void Scanline();
+
+    // number of scanlines to clock until the IRQ line gets asserted; 0: never
+    uint32_t ScanlinesToIRQ() const;
+
+  private:
+    void write_mmc1(Disk &, const uint16_t &, const Byte &);
+    void write_mmc3(Disk &, const uint16_t &, const Byte &);
+
+    void map_mmc1(Disk &);
+    void map_mmc3(Disk &);
+};
@@ -1,16 +1,34 @@
+// ============================================================================
+// The console: CPU, PPU and cartridge, and the scheduler running them.
+//
+// It has no window nor any other I/O: frames are left in `ppu.frame` for a
+// frontend to present (see frontend.hpp, or the headless nesemu-cli).
+// ============================================================================
+
 #pragma once
 
 #include "cpu.hpp"
 #include "disk.hpp"
 #include "ppu.hpp"
-#include <SFML/Graphics.hpp>
+#include "savestate.hpp"
 
 struct NES {
     CPU cpu;
     PPU ppu;
     std::shared_ptr<Disk> disk;
-    sf::RenderWindow window;
-    size_t cycles;
+
+    // Master clock, in PPU dots.
+    //
+    // The PPU's position on it is `ppu.clock`, the CPU's is `Clock()`. The CPU
+    // runs ahead by whole instructions, and the PPU catches up when the CPU
+    // touches its registers, or when the next PPU event is due.
+    //
+    // master clock of the CPU at `cpu.cyc_count == 0`
+    uint64_t clock_base;
+
+    // master clock of the next PPU event (NMI, mapper IRQ, end of frame) the
+    // CPU has to stop at; refreshed whenever the PPU catches up
+    uint64_t deadline;
 
     // Constructor
     NES();
@@ -18,8 +36,25 @@ struct NES {
     ~NES();
 
     void Load(const std::string &);
-    void RunCycle();
+    void Reset();
+
+    // master clock reached by the CPU, i.e. at the end of its last instruction
+    inline uint64_t Clock() const {
+        return clock_base + (cpu.cyc_count + cpu.cycles) * 3;
+    }
+
+    // let the PPU catch up with the CPU
+    void Sync();
+
     void RunFrame();
 
-    void Run();
+    // snapshot the state of the console, see savestate.hpp
+    void Save(SaveState &) const;
+
+    // restore a snapshot, taken with the same ROM attached
+    void Load(const SaveState &);
+
+  private:
+    void skip_idle();
+    void stall_dma();
 };
@@ -0,0 +1,55 @@
+// ============================================================================
+// Speed controller: paces the frames of the console.
+//
+// - UNCAPPED: no waiting at all, as fast as the host runs;
+// - REALTIME: the NTSC frame rate, 60.0988 Hz;
+// - FIXED: the NTSC frame rate times `speed` (2x, 4x, 0.5x, ...).
+//
+// The paced modes wait on a hybrid timer: the thread sleeps until shortly
+// before the deadline, as sleeps may overshoot by a scheduler tick, and spins
+// the rest of the way.
+// ============================================================================
+
+#pragma once
+
+#include <chrono>
+
+#include "const.hpp"
+
+enum class PaceMode : uint8_t {
+    UNCAPPED = 0,
+    REALTIME,
+    FIXED,
+};
+
+struct Pacer {
+    using Clock = std::chrono::steady_clock;
+
+    PaceMode mode;
+    // multiplier of the FIXED mode
+    double speed;
+
+    // Constructor
+    Pacer();
+    // Destructor
+    ~Pacer();
+
+    // switch to a mode, starting from now
+    void Set(const PaceMode &, const double &speed = 1.0);
+
+    // wait until the next frame is due; call once per frame
+    void Wait();
+
+    // frames per second since the last lap (or `Set`), and start a new one
+    double Lap();
+
+  private:
+    // when the next frame is due
+    Clock::time_point next;
+    // duration of a frame in the current mode
+    Clock::duration period;
+
+    // start of the current lap, and frames since then
+    Clock::time_point lap;
+    uint64_t frames;
+};
@@ -8,19 +8,37 @@
 
 #pragma once
 
-#include <SFML/Graphics.hpp>
-
 #include "const.hpp"
 #include "disk.hpp"
 
 struct PPU {
 
-    sf::Image image;
+    // Picture, one RGBA pixel per dot of the visible lines: 4 bytes R, G, B,
+    // A in memory order, i.e. ready to upload as a texture once per frame
+    alignas(64) uint32_t frame[kScreenW * kScreenH];
+
+    // Resolved palette: the pixel each palette address (0x3F00 - 0x3F1F)
+    // shows, PPUMASK greyscale and emphasis applied, the pixels 0 of every
+    // palette showing the universal background color. Refreshed from the
+    // palette RAM whenever `Disk::pal_dirty`.
+    uint32_t colors[32];
+
+    // Sprites of the line being rendered, as evaluated at the end of the
+    // previous one: per dot, the palette address (0x10 - 0x1F) of the
+    // front-most opaque sprite pixel, along with its priority and whether it
+    // belongs to sprite 0; 0: no sprite. See `PPU::eval_sprites`.
+    alignas(64) Byte fg_line[kScreenW];
+    uint8_t fg_count; // number of sprites on the line (0 - 8)
+
     Disk *disk;
 
     RegW scanline;
     RegW cycle;
 
+    // number of dots run since power-up, i.e. the position of the PPU on the
+    // master clock
+    uint64_t clock;
+
     // background 16-bit shift registers:
     //
     // - contain the pattern table data for two tiles
@@ -30,15 +48,14 @@ struct PPU {
     RegW bg_shift_pat_lo;
     RegW bg_shift_pat_hi;
 
-    // background 8-bit shift registers:
+    // background 16-bit shift registers:
     //
-    // - contain the palette attributes for the lower 8 pixels of the 16-bit
-    //   shift register.
-    // - fed by a latch which contains the palette attribute for the next tile.
+    // - contain the palette attributes of the pixels of the pattern shift
+    //   registers, i.e. the attribute bit of a tile repeated 8 times
     // - every 8 cycles
-    //   - the latch is loaded with the palette attribute for the next tile
-    RegB bg_shift_attr_lo;
-    RegB bg_shift_attr_hi;
+    //   - the attribute of the next tile is loaded into the lower 8-bit
+    RegW bg_shift_attr_lo;
+    RegW bg_shift_attr_hi;
 
     // next background tile id
     RegB bg_tile_id;
@@ -51,6 +68,11 @@ struct PPU {
 
     bool nmi;
     bool frame_complete;
+    // odd frames are 1 dot shorter while rendering, see `PPU::RunCycle`
+    bool odd_frame;
+
+    // render the visible lines a whole line at once, see `PPU::Run`
+    bool lines;
 
     // Constructor & Destructor
     PPU();
@@ -74,11 +96,68 @@ struct PPU {
 
     void RunCycle();
 
+    // catch up with the master clock, i.e. run until `clock` reaches `until`
+    void Run(const uint64_t &until);
+
+    // number of dots to run until the next event that concerns the CPU, i.e.
+    // the start of vblank (NMI), the mapper IRQ or the end of the frame
+    uint32_t DotsToEvent() const;
+
     // ------------------------------------------------------------------------
     // helper functions
     // ------------------------------------------------------------------------
 
   private:
+    void render_line();
+
+    void eval_sprites();
+
+    // final pixel of dot `x` of the line, out of the palette address of the
+    // background (after clipping) and `fg_line`
+    uint32_t mix_pixel(const uint16_t &, const Byte &);
+
+    // write the pixels of a line, out of the palette addresses of its
+    // background (after clipping) and `fg_line`
+    void mix_line(uint32_t *, const Byte *);
+
+    // palette address of the background at dot `x` as shown, i.e. 0 where it
+    // is disabled or clipped in the leftmost 8 dots
+    inline Byte clip_bg(const uint16_t &x, const Byte &bg) const {
+        if (!disk->pram.mask.bg || (x < 8 && !disk->pram.mask.bgl))
+            return 0;
+        return bg;
+    }
+
+    void update_colors();
+
+    // refresh `colors` if the palette changed
+    inline void sync_colors() {
+        if (disk->pal_dirty)
+            update_colors();
+    }
+
+    // Palette address (0x00 - 0x0F) of the background pixel at the output of
+    // the shifters
+    inline uint8_t bg_pal_addr() const {
+        // TODO: add documentation
+        const uint16_t bit_mux = 0x8000 >> disk->pram.x;
+
+        // Select plane pixels by extracting from the shifter
+        // at the required location.
+        const uint8_t p0_pixel = (bg_shift_pat_lo & bit_mux) > 0;
+        const uint8_t p1_pixel = (bg_shift_pat_hi & bit_mux) > 0;
+
+        // Combine to form pixel index
+        const uint8_t bg_pixel = (p1_pixel << 1) | p0_pixel;
+
+        // Get palette
+        const uint8_t bg_pal0 = (bg_shift_attr_lo & bit_mux) > 0;
+        const uint8_t bg_pal1 = (bg_shift_attr_hi & bit_mux) > 0;
+        const uint8_t bg_palette = (bg_pal1 << 1) | bg_pal0;
+
+        return (bg_palette << 2) | bg_pixel;
+    }
+
     // update the background shift registers
     inline void update_bg_shift() {
         if (disk->pram.mask.bg) {
@@ -107,12 +186,12 @@ struct PPU {
     inline void fetch_bg_nt() {
         // debug
         // bg_tile_id = (rand() % 2) ? 0x3F : 0x30;
-        bg_tile_id = disk->ReadPBus(0x2000 | (disk->pram.v.reg & 0x0FFF));
+        bg_tile_id = disk->ReadNT(disk->pram.v.reg);
     }
 
     inline void fetch_bg_at() {
-        bg_tile_attr = disk->ReadPBus(
-            0x23C0 | (disk->pram.v.nty << 11) | (disk->pram.v.ntx << 10) |
+        bg_tile_attr = disk->ReadNT(
+            0x03C0 | (disk->pram.v.nty << 11) | (disk->pram.v.ntx << 10) |
             ((disk->pram.v.y_coarse >> 2) << 3) | (disk->pram.v.x_coarse >> 2));
 
         if (disk->pram.v.y_coarse & 0x02)
@@ -204,111 +283,16 @@ struct PPU {
         if (disk->pram.mask.bg || disk->pram.mask.fg) {
             disk->pram.v.y = disk->pram.t.y;
             disk->pram.v.nty = disk->pram.t.nty;
-            disk->pram.v.y_coarse = disk->pram.v.y_coarse;
+            disk->pram.v.y_coarse = disk->pram.t.y_coarse;
         }
     };
 
-    // a whole BG fetch loop
-    // NOTE: cycle MUST be in [1, 258) or [321, 338) (TODO: check)
-    inline void bg_fetch_loop() {
-        update_bg_shift();
-        switch ((cycle - 1) % 8) {
-        case 0:
-            load_bg_shift();
-            fetch_bg_nt();
-            break;
-        case 2:
-            fetch_bg_at();
-            break;
-        case 4:
-            fetch_bg_tile_lo();
-            break;
-        case 6:
-            fetch_bg_tile_hi();
-            break;
-        case 7:
-            inc_bg_x();
-            break;
-        }
-    };
-
-    // Pre-render (scanline 261)
-    inline void pre_render() {
-        if (cycle == 1) {
-            // - cycle 1
-            //   - clear VBlank flag
-            //   - clear sprite overflow flag
-            //   - clear sprite 0-hit flag
-            //   - TODO: Clear Shift registers
-            disk->pram.status.vbk = 0;
-            disk->pram.status.fgof = 0;
-            disk->pram.status.fgzh = 0;
-        } else if (cycle == 256) {
-            bg_fetch_loop();
-            inc_bg_y();
-        } else if (cycle == 257) {
-            bg_fetch_loop();
-            load_bg_shift();
-            transfer_x();
-        } else if ((cycle >= 1 && cycle < 258) ||
-                   (cycle >= 321 && cycle < 338)) {
-            bg_fetch_loop();
-        } else if (cycle == 338 || cycle == 340) {
-            fetch_bg_nt();
-        }
-        // TODO: integrate above as a mutuall exclusive function
-        if (cycle >= 280 && cycle < 305) {
-            transfer_y();
-        }
-    }
-
-    // render init (scanline 0)
-    inline void render_init() {
-        if (cycle == 0) {
-            // "Odd Frame" cycle skip
-            cycle = 1;
-        } else if (cycle == 256) {
-            bg_fetch_loop();
-            inc_bg_y();
-        } else if (cycle == 257) {
-            bg_fetch_loop();
-            load_bg_shift();
-            transfer_x();
-        } else if ((cycle >= 1 && cycle < 258) ||
-                   (cycle >= 321 && cycle < 338)) {
-            bg_fetch_loop();
-        } else if (cycle == 338 || cycle == 340) {
-            fetch_bg_nt();
-        }
-    }
-
-    // render (scanline 1-239)
-    inline void render() {
-        if (cycle == 256) {
-            bg_fetch_loop();
-            inc_bg_y();
-        } else if (cycle == 257) {
-            bg_fetch_loop();
-            load_bg_shift();
-            transfer_x();
-        } else if ((cycle >= 1 && cycle < 258) ||
-                   (cycle >= 321 && cycle < 338)) {
-            bg_fetch_loop();
-        } else if (cycle == 338 || cycle == 340) {
-            fetch_bg_nt();
-        }
-    }
-
-    // vblank (scanline 241)
-    inline void vblank() {
-        if (cycle == 1) {
-            // - cycle 1
-            //   - set VBlank flag
-            //   - if NMI is enabled, trigger NMI
-            disk->pram.status.vbk = 1;
-            if (disk->pram.ctrl.nmi) {
-                nmi = true;
-            }
+    // Clock the scanline counter of the mapper (MMC3), which happens on the
+    // rendering lines when the PPU fetches sprite patterns (dot 260)
+    inline void clock_scanline() {
+        if ((disk->pram.mask.bg || disk->pram.mask.fg) &&
+            disk->mapper.id == MapperId::MMC3) {
+            disk->mapper.Scanline();
         }
     }
 };
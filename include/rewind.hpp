@@ -0,0 +1,86 @@
+// ============================================================================
+// Rewind: a history of savestates, in a ring of fixed size
+//
+// Every `interval` frames a snapshot of the console (see savestate.hpp) is
+// taken, and stored as its difference with the previous one: XORed with it,
+// mostly zeros as most of the memory does not change from a frame to the
+// next, then run-length encoded. Only the newest snapshot is kept whole;
+// stepping back restores it, then XORs the newest delta into it to get the
+// one before.
+//
+// The oldest snapshots are dropped to make room for new ones, so that the
+// history never takes more than the capacity of the ring.
+//
+//   Encoding of a delta, as tokens of:
+//
+//   - u16: number of unchanged bytes
+//   - u16: number of changed bytes
+//   - the changed bytes, XORed with the previous snapshot
+// ============================================================================
+
+#pragma once
+
+#include <deque>
+#include <memory>
+
+#include "const.hpp"
+#include "nes.hpp"
+
+struct Rewind {
+
+    // snapshot every `interval` frames
+    uint32_t interval;
+
+    // ---------- Statistics ----------
+
+    // snapshots taken, and the time taken by them (snapshot and encoding)
+    uint64_t pushed;
+    double push_time;     // in total, in seconds
+    double push_time_max; // the longest, in seconds
+
+    // Constructor: a ring of `capacity` bytes, a snapshot every `interval`
+    // frames
+    Rewind(const size_t &capacity, const uint32_t &interval);
+    // Destructor
+    ~Rewind();
+
+    // Call once per frame: take a snapshot, if due
+    void Push(const NES &);
+
+    // Restore the newest snapshot, and drop it; false if there is none
+    bool Step(NES &);
+
+    // Drop the whole history
+    void Clear();
+
+    // number of snapshots `Step` can go back to
+    size_t Count() const;
+
+    // bytes of the ring in use
+    size_t Used() const;
+
+  private:
+    // a delta in the ring
+    struct Entry {
+        size_t offset;
+        size_t size;
+    };
+
+    // the encoded deltas, back to back, and where they are (oldest first);
+    // `head`: where the next one goes
+    Mem ring;
+    std::deque<Entry> entries;
+    size_t head;
+    size_t used;
+
+    // the newest snapshot, whole; invalid until the first snapshot
+    std::unique_ptr<SaveState> last;
+    bool has_last;
+
+    // the snapshot being taken, and its delta before it goes into the ring
+    std::unique_ptr<SaveState> cur;
+    Mem scratch;
+
+    // frames since the last snapshot
+    uint32_t frames;
+};
@@ -0,0 +1,48 @@
+// ============================================================================
+// ROM image of a cartridge (iNES), mapped read-only and shared by all the
+// disks of the process that attach the same contents
+// ============================================================================
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "const.hpp"
+#include "neshdr.hpp"
+
+struct Rom {
+
+    NesHdr header;
+
+    // PRG-ROM / CHR-ROM inside the image
+    const Byte *prg;
+    const Byte *chr;
+    uint32_t prg_size;
+    uint32_t chr_size; // 0: the cartridge has CHR-RAM instead
+
+    // CHR-ROM decoded once for all the disks, 64 bytes per tile (see `Chr`)
+    Mem tiles;
+
+    // hash of the whole image, the key of the cache
+    uint64_t hash;
+
+    // the whole image: either mapped from the file, or read into `buffer` on
+    // platforms without `mmap`
+    const Byte *data;
+    size_t size;
+    bool mapped;
+    Mem buffer;
+
+    // ---------- Constructor & Destructor ----------
+
+    Rom();
+    ~Rom();
+
+    // the mapping is owned by the instance
+    Rom(const Rom &) = delete;
+    Rom &operator=(const Rom &) = delete;
+
+    // Load a ROM image, or get the one already loaded with the same contents
+    static std::shared_ptr<const Rom> Load(const std::string &);
+};
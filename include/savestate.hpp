@@ -0,0 +1,129 @@
+// ============================================================================
+// Savestate: all the mutable state of the console, in one flat POD
+//
+// A snapshot is a handful of memcpy's into a `SaveState`, and the state is
+// then a contiguous buffer of `sizeof(SaveState)` bytes, to be copied, stored
+// or compared as such. It leaves out:
+//
+// - the ROM: a state only restores onto a console with the same ROM attached,
+//   as identified by `Rom::hash`;
+// - pointers (banks, mirrors, page tables, the disk of the CPU and PPU): the
+//   banks are stored as bank numbers, and mapped again on restore;
+// - what is derived from the rest: decoded instructions and tiles, the
+//   resolved palette, and the picture of the PPU, which the next frame draws
+//   again.
+//
+// The layout changes with the emulator; `kVersion` is bumped whenever it
+// does, and states of other versions are refused.
+// ============================================================================
+
+#pragma once
+
+#include <type_traits>
+
+#include "const.hpp"
+#include "cpu.hpp"
+#include "disk.hpp"
+
+struct SaveState {
+
+    // "NESS", in memory order
+    static constexpr uint32_t kMagic = 0x5353454E;
+    static constexpr uint32_t kVersion = 1;
+
+    // size of the cartridge RAM: PRG-RAM (8KB), and CHR-RAM (8KB) if any
+    static constexpr uint32_t kCartRAMSize = 0x4000;
+
+    // ---------- Header ----------
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t rom; // `Rom::hash` of the ROM attached
+
+    // ---------- CPU ----------
+
+    struct {
+        RegW PC;
+        CPU::RegF RF;
+        CPU::LazyF LF;
+        RegB RA;
+        RegB RX;
+        RegB RY;
+        RegB SP;
+        uint16_t cycles;
+        RegW TABS;
+        RegW TREL;
+        RegB TDAT;
+        uint64_t cyc_count;
+        uint16_t addr;
+        uint8_t opcode;
+        AddrMode mode;
+        Instruct instr;
+        uint8_t n_param;
+        uint8_t lhs;
+        uint8_t rhs;
+    } cpu;
+
+    // ---------- PPU ----------
+
+    struct {
+        Byte fg_line[kScreenW];
+        uint8_t fg_count;
+        RegW scanline;
+        RegW cycle;
+        uint64_t clock;
+        RegW bg_shift_pat_lo;
+        RegW bg_shift_pat_hi;
+        RegW bg_shift_attr_lo;
+        RegW bg_shift_attr_hi;
+        RegB bg_tile_id;
+        RegB bg_tile_attr;
+        RegB bg_tile_lo;
+        RegB bg_tile_hi;
+        bool nmi;
+        bool frame_complete;
+        bool odd_frame;
+    } ppu;
+
+    // ---------- Disk ----------
+
+    struct {
+        Byte ram[kRAMSize];
+        Byte vrm[kVRAMSize];
+        Byte pal[kPaletteSize];
+        OAM oam;
+        Byte cart[kCartRAMSize];
+        PMem pram;
+        bool oam_dma;
+        MirrorMode mirror;
+        // 8KB PRG-ROM banks of the slots of 0x8000 - 0xFFFF, 1KB CHR banks of
+        // the slots of the pattern tables
+        uint32_t prg_bank[4];
+        uint32_t chr_bank[8];
+    } disk;
+
+    // ---------- Mapper ----------
+
+    struct {
+        uint8_t shift;
+        uint8_t n_shift;
+        uint8_t control;
+        uint8_t chr0;
+        uint8_t chr1;
+        uint8_t prg;
+        uint8_t select;
+        uint8_t bank[8];
+        uint8_t irq_latch;
+        uint8_t irq_counter;
+        bool irq_reload;
+        bool irq_enable;
+        bool irq;
+    } mapper;
+
+    // ---------- Scheduler ----------
+
+    uint64_t clock_base;
+};
+
+static_assert(std::is_trivially_copyable_v<SaveState>,
+              "a savestate must be copyable as bytes");
@@ -0,0 +1,52 @@
+// ============================================================================
+// Lock-free single-producer single-consumer queue, of a fixed capacity
+//
+// A ring of `N` slots, with the producer only ever moving `tail` and the
+// consumer only ever moving `head`. Neither blocks: `Push` fails when the
+// queue is full, `Pop` when it is empty.
+// ============================================================================
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N> struct SpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+    // Constructor
+    SpscQueue() {
+        head = 0;
+        tail = 0;
+    }
+
+    // ---------- Producer ----------
+
+    inline bool Push(const T &item) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // ---------- Consumer ----------
+
+    inline bool Pop(T &item) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    std::array<T, N> items;
+
+    // number of items popped / pushed so far, each on its own cache line
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
@@ -0,0 +1,62 @@
+// ============================================================================
+// Lock-free triple buffer: one writer publishing values (e.g. frames) to one
+// reader, neither of them ever waiting for the other.
+//
+// The writer fills the back slot and publishes it by swapping it with the
+// middle one; the reader takes the middle slot, if anything new was
+// published, by swapping it with the front one. The reader always gets the
+// newest value published, the older ones are overwritten.
+// ============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "const.hpp"
+
+template <typename T> struct TripleBuffer {
+
+    // Constructor
+    TripleBuffer() : slots(std::make_unique<T[]>(3)) {
+        back = 0;
+        middle = 1;
+        front = 2;
+    }
+
+    // ---------- Writer ----------
+
+    // slot to fill before publishing it
+    inline T &Back() { return slots[back]; }
+
+    // publish the back slot, and get a free one in return
+    inline void Publish() {
+        back = middle.exchange(back | kNew, std::memory_order_acq_rel) & kSlot;
+    }
+
+    // ---------- Reader ----------
+
+    // take the newest value published, if any since the last call
+    inline bool Fetch() {
+        if (!(middle.load(std::memory_order_relaxed) & kNew))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & kSlot;
+        return true;
+    }
+
+    // value taken by the last successful `Fetch`
+    inline const T &Front() const { return slots[front]; }
+
+  private:
+    // the middle slot has been published and not fetched yet
+    static constexpr uint8_t kNew = 0x04;
+    static constexpr uint8_t kSlot = 0x03;
+
+    std::unique_ptr<T[]> slots;
+
+    // slot indexes: back is the writer's, front the reader's, the middle one
+    // is exchanged between them; each on its own cache line
+    alignas(64) uint8_t back;
+    alignas(64) std::atomic<uint8_t> middle;
+    alignas(64) uint8_t front;
+};
@@ -0,0 +1,93 @@
+// nesemu-cli: run a ROM headless for a number of frames.
+//
+// Usage: nesemu-cli [--blocks] <rom> [frames] [speed]
+//
+// speed: "max" (the default) runs as fast as possible, a number paces the
+// frames at that multiple of the NTSC frame rate (1: realtime, 2, 0.5, ...).
+//
+// --blocks runs straight-line blocks of PRG code at once, see `CPU::RunBlock`.
+//
+// Prints the speed reached and a hash of the last frame, so that runs can be
+// compared against each other without a display.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "nes.hpp"
+#include "pacer.hpp"
+
+// FNV-1a over the RGBA bytes of the frame
+static uint32_t hash_frame(const uint32_t *frame) {
+    const Byte *px = (const Byte *)frame;
+    uint32_t hash = 0x811C9DC5;
+    for (uint32_t i = 0; i < kScreenW * kScreenH * 4; i++)
+        hash = (hash ^ px[i]) * 0x01000193;
+    return hash;
+}
+
+int main(int argc, char **argv) {
+    // options anywhere, the rest in order
+    bool blocks = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--blocks")
+            blocks = true;
+        else
+            args.push_back(arg);
+    }
+    if (args.empty()) {
+        std::fprintf(stderr, "usage: %s [--blocks] <rom> [frames] [speed]\n",
+                     argv[0]);
+        return 1;
+    }
+    const long frames =
+        args.size() > 1 ? std::strtol(args[1].c_str(), nullptr, 10) : 600;
+    if (frames <= 0) {
+        std::fprintf(stderr, "invalid number of frames: %s\n",
+                     args[1].c_str());
+        return 1;
+    }
+
+    Pacer pacer;
+    const std::string speed = args.size() > 2 ? args[2] : "max";
+    if (speed == "max") {
+        pacer.Set(PaceMode::UNCAPPED);
+    } else {
+        const double s = std::strtod(speed.c_str(), nullptr);
+        if (s <= 0) {
+            std::fprintf(stderr, "invalid speed: %s\n", speed.c_str());
+            return 1;
+        }
+        pacer.Set(s == 1.0 ? PaceMode::REALTIME : PaceMode::FIXED, s);
+    }
+
+    NES nes;
+    nes.cpu.blocks = blocks;
+    try {
+        nes.Load(args[0]);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    pacer.Lap();
+    for (long i = 0; i < frames; i++) {
+        nes.RunFrame();
+        pacer.Wait();
+    }
+    const double fps = pacer.Lap();
+    const double dt = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+
+    std::printf("%ld frames in %.3f s (%.1f fps, %.2fx realtime, speed %s)\n",
+                frames, dt, fps, fps / 60.0988, speed.c_str());
+    std::printf("frame hash %08x\n", hash_frame(nes.ppu.frame));
+    return 0;
+}
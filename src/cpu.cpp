@@ -1,5 +1,7 @@
+#include <array>
 #include <iostream>
 #include <string>
+#include <utility>
 
 #include "cpu.hpp"
 #include "misc.hpp"
@@ -12,7 +14,7 @@ static const std::vector<std::string> map_str_addrmode = {
 };
 
 // map addressing mode to function pointer
-static const std::vector<void (CPU::*)(void)> map_func_addrmode = {
+static constexpr std::array<void (CPU::*)(void), 16> map_func_addrmode = {
     &CPU::XXX, &CPU::IMP, &CPU::IMM, &CPU::ZPG, &CPU::ZPX, &CPU::ZPY,
     &CPU::REL, &CPU::ABS, &CPU::ABX, &CPU::AXP, &CPU::ABY, &CPU::AYP,
     &CPU::IND, &CPU::IZX, &CPU::IZY, &CPU::IYP,
@@ -20,7 +22,7 @@ static const std::vector<void (CPU::*)(void)> map_func_addrmode = {
 
 // map addressing mode to number of addresses to read.
 // This is to indicate whether the operation is nullary, unary, or binary.
-static const std::vector<uint8_t> map_addrs = {
+static constexpr std::array<uint8_t, 16> map_addrs = {
     0, // UNK
     0, // IMP
     1, // IMM
@@ -52,7 +54,7 @@ static const std::vector<std::string> map_str_instruct = {
 };
 
 // map instruction to function pointer
-static const std::vector<void (CPU::*)(void)> map_func_instruct = {
+static constexpr std::array<void (CPU::*)(void), 73> map_func_instruct = {
     &CPU::XXX, &CPU::BRK, &CPU::ORA, &CPU::ORI, &CPU::XXX, &CPU::NOP, &CPU::ASL,
     &CPU::ALA, &CPU::PHP, &CPU::CLC, &CPU::JSR, &CPU::BIT, &CPU::AND, &CPU::ANI,
     &CPU::ROL, &CPU::RLA, &CPU::PLP, &CPU::BMI, &CPU::SEC, &CPU::RTI, &CPU::EOR,
@@ -75,7 +77,7 @@ struct Operation {
 };
 
 // map opcode to corresponding addressing mode and instruction
-static const std::vector<Operation> map_op = {
+static constexpr std::array<Operation, 256> map_op = {{
     {Instruct::BRK, AddrMode::IMM, 7}, // 0x00
     {Instruct::ORA, AddrMode::IZX, 6}, // 0x01
     {Instruct::XXX, AddrMode::IMP, 2}, // 0x02
@@ -332,7 +334,315 @@ static const std::vector<Operation> map_op = {
     {Instruct::SBC, AddrMode::ABX, 4}, // 0xFD
     {Instruct::INC, AddrMode::AXP, 7}, // 0xFE
     {Instruct::XXX, AddrMode::IMP, 7}, // 0xFF
-};
+}};
+
+// ----------------------------------------------------------------------------
+// Fused opcode handlers
+// ----------------------------------------------------------------------------
+
+// Fused handler of a single opcode.
+//
+// - Generated at compile time from `map_op`: the addressing mode, the
+//   instruction and the base cycles are all constants, so both member function
+//   calls are resolved statically and can be inlined into one body.
+// - FETCH: whether the operands are read from the main bus (and PC advanced).
+//   Otherwise they are expected to be in `lhs` / `rhs` already.
+template <Byte OP, bool FETCH> static void exec_op(CPU &cpu) {
+    constexpr Operation op = map_op[OP];
+    constexpr uint8_t n = map_addrs[(uint8_t)op.addrmode];
+    constexpr auto fa = map_func_addrmode[(uint8_t)op.addrmode];
+    constexpr auto fi = map_func_instruct[(uint8_t)op.instruct];
+
+    if constexpr (FETCH) {
+        if constexpr (n >= 1)
+            cpu.lhs = cpu.disk->ReadMBus(cpu.PC++);
+        if constexpr (n >= 2)
+            cpu.rhs = cpu.disk->ReadMBus(cpu.PC++);
+    }
+
+    // logging
+    cpu.opcode = OP;
+    cpu.mode = op.addrmode;
+    cpu.instr = op.instruct;
+    cpu.n_param = n;
+
+    cpu.cycles = op.cycles;
+    cpu.RF.U = 1;
+    (cpu.*fa)();
+    (cpu.*fi)();
+    cpu.RF.U = 1;
+}
+
+// build the dispatch table of all 256 fused handlers
+template <bool FETCH, size_t... OP>
+static constexpr std::array<CPU::OpFunc, 256>
+make_op_table(std::index_sequence<OP...>) {
+    return {&exec_op<(Byte)OP, FETCH>...};
+}
+
+// map opcode to fused handler, fetching operands from the main bus
+static constexpr auto map_func_op =
+    make_op_table<true>(std::make_index_sequence<256>{});
+
+// map opcode to fused handler, with operands already decoded by `Read`
+static constexpr auto map_func_exec =
+    make_op_table<false>(std::make_index_sequence<256>{});
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// Decode the instruction at `pc` (MUST be in the PRG window) into `d`.
+//
+// Instructions running across two 8KB slots are left invalid, as their
+// operands depend on the bank mapped to the 2nd slot. They always take the
+// slow path.
+static inline void decode(CPU &cpu, CPU::Decoded &d, const uint16_t pc) {
+    Byte opcode = cpu.disk->ReadMBus(pc);
+    const Operation &op = map_op[opcode];
+    uint8_t n = map_addrs[(uint8_t)op.addrmode];
+
+    d.opcode = opcode;
+    d.lhs = n >= 1 ? cpu.disk->ReadMBus(pc + 1) : 0x00;
+    d.rhs = n >= 2 ? cpu.disk->ReadMBus(pc + 2) : 0x00;
+    d.len = 1 + n;
+    d.cycles = op.cycles;
+    d.ok = (pc & 0x1FFF) + d.len <= 0x2000;
+    d.blen = CPU::kBlockNone;
+    d.idle = CPU::kIdleNone;
+}
+
+// Look up the decoded instructions of the bank mapped to `slot`, allocating
+// them the first time the bank runs code.
+static void map_slot(CPU &cpu, const uint8_t slot) {
+    const Disk &disk = *cpu.disk;
+    const size_t n = disk.prg_kb / 8;
+    if (cpu.irom != disk.rom) {
+        // decoded instructions of any previous ROM are meaningless
+        cpu.irom = disk.rom;
+        cpu.ibank.clear();
+        cpu.ibank.resize(n + 1);
+    }
+
+    const Byte *mem = disk.page_rd[0x80 + slot * 0x20];
+    size_t bank = n;
+    if (disk.prg && mem >= disk.prg && mem < disk.prg + n * 0x2000)
+        bank = (mem - disk.prg) / 0x2000;
+    std::unique_ptr<CPU::Decoded[]> &decoded = cpu.ibank[bank];
+    if (!decoded) {
+        decoded = std::make_unique<CPU::Decoded[]>(0x2000);
+        if (bank == n) {
+            // not PRG-ROM: never served from the cache
+            for (size_t i = 0; i < 0x2000; i++)
+                decoded[i].len = 1;
+        }
+    }
+    cpu.islot[slot] = decoded.get();
+    cpu.irev[slot] = disk.prg_rev[slot];
+}
+
+// Get the decoded instruction at `pc` (MUST be in the PRG window)
+static inline CPU::Decoded &lookup(CPU &cpu, const uint16_t pc) {
+    const uint8_t slot = (pc >> 13) & 0x03;
+    if (cpu.irev[slot] != cpu.disk->prg_rev[slot])
+        map_slot(cpu, slot);
+    CPU::Decoded &d = cpu.islot[slot][pc & 0x1FFF];
+    if (d.len == 0)
+        decode(cpu, d, pc);
+    return d;
+}
+
+// Whether the instruction writes to the address it operates on
+static inline constexpr bool is_write(const Instruct &ins) {
+    switch (ins) {
+    case Instruct::STA:
+    case Instruct::STX:
+    case Instruct::STY:
+    case Instruct::ASL:
+    case Instruct::LSR:
+    case Instruct::ROL:
+    case Instruct::ROR:
+    case Instruct::INC:
+    case Instruct::DEC:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Whether the instruction changes the control flow, i.e. ends a block
+static inline constexpr bool is_jump(const Operation &op) {
+    switch (op.instruct) {
+    case Instruct::JMP:
+    case Instruct::JSR:
+    case Instruct::RTS:
+    case Instruct::RTI:
+    case Instruct::BRK:
+        return true;
+    default:
+        return op.addrmode == AddrMode::REL;
+    }
+}
+
+// Whether accessing [lo, hi] of the main bus is free of side effects outside
+// of the CPU and RAM, i.e. it can NOT reach the PPU / APU registers, or the
+// mapper registers when writing.
+static inline constexpr bool is_plain(const uint32_t &lo, const uint32_t &hi,
+                                      const bool &write) {
+    if (hi > 0xFFFF)
+        return false;
+    return hi < 0x2000 || (lo >= 0x4020 && !write);
+}
+
+// Whether the instruction can be run inside a block, judging by the addresses
+// it may access. Indirect modes are decided at runtime, so they never are.
+static inline bool is_block_safe(const Operation &op, const CPU::Decoded &d) {
+    const uint32_t a = ((uint32_t)d.rhs << 8) | d.lhs;
+    const bool w = is_write(op.instruct);
+    switch (op.addrmode) {
+    case AddrMode::UNK:
+    case AddrMode::IMP:
+    case AddrMode::IMM:
+    case AddrMode::REL:
+    case AddrMode::ZPG:
+    case AddrMode::ZPX:
+    case AddrMode::ZPY:
+        return true;
+    case AddrMode::ABS:
+        // no data access, only PC (and stack) changes
+        if (op.instruct == Instruct::JMP || op.instruct == Instruct::JSR)
+            return true;
+        return is_plain(a, a, w);
+    case AddrMode::ABX:
+    case AddrMode::AXP:
+    case AddrMode::ABY:
+    case AddrMode::AYP:
+        return is_plain(a, a + 0xFF, w);
+    case AddrMode::IND:
+        return is_plain(a, a + 1, false);
+    default:
+        return false;
+    }
+}
+
+// Whether the instruction can be part of the body of an idle loop, i.e. it
+// only reads RAM, PRG-ROM or PPUSTATUS, and running it again on the same memory
+// yields the same registers and flags.
+static inline bool is_idle_safe(const Operation &op, const CPU::Decoded &d) {
+    switch (op.instruct) {
+    case Instruct::NOP:
+    case Instruct::LDA:
+    case Instruct::LAI:
+    case Instruct::LDX:
+    case Instruct::LXI:
+    case Instruct::LDY:
+    case Instruct::LYI:
+    case Instruct::BIT:
+    case Instruct::CMP:
+    case Instruct::CMI:
+    case Instruct::CPX:
+    case Instruct::CXI:
+    case Instruct::CPY:
+    case Instruct::CYI:
+    case Instruct::AND:
+    case Instruct::ANI:
+    case Instruct::ORA:
+    case Instruct::ORI:
+        break;
+    default:
+        return false;
+    }
+
+    const uint16_t a = ((uint16_t)d.rhs << 8) | d.lhs;
+    switch (op.addrmode) {
+    case AddrMode::IMP:
+    case AddrMode::IMM:
+    case AddrMode::ZPG:
+    case AddrMode::ZPX:
+    case AddrMode::ZPY:
+        return true;
+    case AddrMode::ABS:
+        // RAM, PPUSTATUS (and its mirrors), PRG-ROM
+        return a < 0x2000 || (a < 0x4000 && (a & 0x0007) == 0x0002) ||
+               a >= 0x8000;
+    default:
+        return false;
+    }
+}
+
+// Analyze the loop from `pc` (target) to the branch `br` at `br_pc`.
+//
+// Returns the cycles per iteration if the loop is idle, 0 otherwise.
+static uint8_t analyze_idle(CPU &cpu, const CPU::Decoded &br,
+                            const uint16_t br_pc, const uint16_t pc) {
+    const uint8_t slot = (br_pc >> 13) & 0x03;
+    if (br_pc - pc > CPU::kIdleMax || ((pc >> 13) & 0x03) != slot)
+        return 0;
+
+    const Operation &br_op = map_op[cpu.disk->ReadMBus(br_pc)];
+
+    // Only the vblank flag of PPUSTATUS changes at an event of the scheduler:
+    // sprite 0 hit and overflow do not. A loop polling PPUSTATUS is only idle
+    // when its branch tests bit 7 (N) straight off the read, i.e. the last
+    // instruction is LDA / LDX / LDY / BIT of PPUSTATUS and the branch BPL /
+    // BMI, without masking (AND, CMP, ...) or Z / V tests in between.
+    bool status = false; // some instruction reads PPUSTATUS
+    bool last = false;   // the last one does, and only copies it
+    uint16_t cycles = 0;
+    uint16_t p = pc;
+    while (p < br_pc) {
+        const CPU::Decoded &d = lookup(cpu, p);
+        const Operation &op = map_op[d.opcode];
+        if (!d.ok || !is_idle_safe(op, d))
+            return 0;
+        const uint16_t a = ((uint16_t)d.rhs << 8) | d.lhs;
+        last = op.addrmode == AddrMode::ABS && a >= 0x2000 && a < 0x4000;
+        status |= last;
+        last &= op.instruct == Instruct::LDA || op.instruct == Instruct::LDX ||
+                op.instruct == Instruct::LDY || op.instruct == Instruct::BIT;
+        cycles += op.cycles;
+        p += d.len;
+    }
+    if (p != br_pc)
+        return 0;
+    if (status && !(last && (br_op.instruct == Instruct::BPL ||
+                             br_op.instruct == Instruct::BMI))) {
+        return 0;
+    }
+
+    // taken branch: +1, and +1 more if crossing a page
+    cycles += br_op.cycles + 1;
+    if ((pc & 0xFF00) != ((br_pc + br.len) & 0xFF00))
+        cycles++;
+    return cycles;
+}
+
+// Translate the straight-line block starting at `pc` (MUST be in the PRG
+// window), and record its length in `head`.
+//
+// A block ends after a jump / branch, or before any instruction that may
+// access the PPU / APU / mapper registers, which then runs through `Step` so
+// that the scheduler gets the chance to synchronize. It never leaves the 8KB
+// slot it starts in, so that it is invalidated along with `head`.
+static void translate(CPU &cpu, CPU::Decoded &head, const uint16_t pc) {
+    const uint8_t slot = (pc >> 13) & 0x03;
+    uint16_t p = pc;
+    uint8_t n = 0;
+
+    while (n < CPU::kBlockMax && ((p >> 13) & 0x03) == slot && p >= 0x8000) {
+        const CPU::Decoded &d = lookup(cpu, p);
+        if (!d.ok)
+            break;
+        const Operation &op = map_op[d.opcode];
+        if (!is_block_safe(op, d))
+            break;
+        n++;
+        p += d.len;
+        if (is_jump(op))
+            break;
+    }
+    head.blen = n;
+}
 
 // ----------------------------------------------------------------------------
 // CPU class
@@ -341,7 +651,7 @@ static const std::vector<Operation> map_op = {
 // Constructor
 CPU::CPU() {
     // keep only interrupt disable flag set
-    RF.reg = 0b00000100;
+    LoadF(0b00000100);
 
     // Initialize registers
     PC = 0x0000;
@@ -356,15 +666,35 @@ CPU::CPU() {
     TDAT = 0x00;
     TABS = TREL = 0x0000;
 
+    // Initialize the current instruction
+    addr = 0x0000;
+    opcode = 0x00;
+    mode = AddrMode::UNK;
+    instr = Instruct::UNK;
+    n_param = 0;
+    lhs = rhs = 0x00;
+
     // Initialize memory to nullptr
     disk = nullptr;
+    std::fill(std::begin(islot), std::end(islot), nullptr);
+    std::fill(std::begin(irev), std::end(irev), 0);
+    blocks = false;
+    idle_skip = true;
 }
 
 // Destructor
 CPU::~CPU() {}
 
 // TODO: shared_ptr
-void CPU::Mount(const Disk &disk) { this->disk = (Disk *)&disk; }
+void CPU::Mount(const Disk &disk) {
+    this->disk = (Disk *)&disk;
+    // decoded instructions of any previous disk are meaningless, look the
+    // slots up again
+    irom = nullptr;
+    ibank.clear();
+    for (uint8_t i = 0; i < 4; i++)
+        irev[i] = disk.prg_rev[i] - 1;
+}
 
 void CPU::Read() {
     // update total cycles, used when initializing in combination with RunInstr
@@ -372,7 +702,7 @@ void CPU::Read() {
     cyc_count += cycles;
     // update with new instruction
     addr = PC;
-    Byte opcode = disk->ReadMBus(PC++);
+    opcode = disk->ReadMBus(PC++);
     Operation op = map_op[opcode];
     mode = op.addrmode;
     instr = op.instruct;
@@ -393,30 +723,111 @@ void CPU::Read() {
     }
 }
 
+// Fetch, decode and execute a whole instruction.
+//
+// Equivalent to `Read` followed by `RunInstr`, but with a single dispatch into
+// the fused opcode handlers.
+//
+// Instructions in PRG-ROM are decoded only once per bank, and then served from
+// `ibank` wherever the bank is mapped. Code running from RAM is fetched and
+// decoded every time.
+void CPU::Step() {
+    // update total cycles with the previous instruction
+    cyc_count += cycles;
+    addr = PC;
+    if (PC >= 0x8000) {
+        const Decoded &d = lookup(*this, PC);
+        if (d.ok) {
+            lhs = d.lhs;
+            rhs = d.rhs;
+            PC += d.len;
+            map_func_exec[d.opcode](*this);
+            return;
+        }
+    }
+    map_func_op[disk->ReadMBus(PC++)](*this);
+}
+
+// Run a straight-line block of PRG code at once.
+//
+// - The block is translated once from the decoded instructions, and then runs
+//   as a tight loop over the fused handlers, without returning to the caller
+//   in between.
+// - The cycles of the whole block are charged at once, i.e. `cycles` holds the
+//   cycles of the block afterwards.
+// - The block stops early once it ran for `budget` cycles, i.e. at the same
+//   instruction stepping would stop at, so that the events the scheduler
+//   predicted (NMI, mapper IRQ) are not taken late.
+// - Falls back to `Step` for a single instruction where no block can be
+//   formed, e.g. code in RAM or any access to the PPU / APU registers.
+void CPU::RunBlock(const uint32_t &budget) {
+    if (PC < 0x8000) {
+        Step();
+        return;
+    }
+    Decoded &head = lookup(*this, PC);
+    if (head.ok && head.blen == kBlockNone) {
+        translate(*this, head, PC);
+    }
+    if (!head.ok || head.blen == 0) {
+        Step();
+        return;
+    }
+
+    // update total cycles with the previous instruction
+    cyc_count += cycles;
+    uint16_t total = 0;
+    // the block never leaves the slot it starts in
+    const Decoded *bank = islot[(PC >> 13) & 0x03];
+    for (uint8_t i = head.blen; i > 0 && total < budget; i--) {
+        const Decoded &d = bank[PC & 0x1FFF];
+        addr = PC;
+        lhs = d.lhs;
+        rhs = d.rhs;
+        PC += d.len;
+        map_func_exec[d.opcode](*this);
+        total += cycles;
+    }
+    cycles = total;
+}
+
+// Detect an idle loop.
+//
+// MUST be called right after a branch at `addr` jumped back to `PC`. If the
+// loop in between only reads RAM / PPUSTATUS and has no side effects, every
+// iteration has the same outcome until memory changes, i.e. until the next PPU
+// event or interrupt. Returns the cycles per iteration in that case, so that
+// the scheduler can skip iterations up to its next event; 0 otherwise.
+//
+// The result is cached along with the decoded branch.
+uint8_t CPU::IdleCycles() {
+    if (!idle_skip || addr < 0x8000 || PC >= addr)
+        return 0;
+    const uint8_t slot = (addr >> 13) & 0x03;
+    if (irev[slot] != disk->prg_rev[slot])
+        return 0;
+    Decoded &br = islot[slot][addr & 0x1FFF];
+    if (!br.ok)
+        return 0;
+    if (br.idle == kIdleNone)
+        br.idle = analyze_idle(*this, br, addr, PC);
+    return br.idle;
+}
+
 // Run one cycle
 void CPU::RunCycle() {
     if (cycles == 0) {
-        // fetch
-        Read();
-        // set unused flag
-        RF.U = 1;
-        // execute
-        (this->*map_func_addrmode[(uint8_t)mode])();
-        (this->*map_func_instruct[(uint8_t)instr])();
-        // set unused flag
-        RF.U = 1;
+        if (blocks)
+            RunBlock();
+        else
+            Step();
     }
     cycles--;
     cyc_count++;
 }
 
-// Run a complete instruction and return the number of cycles it takes
-void CPU::RunInstr() {
-    RF.U = 1;
-    (this->*map_func_addrmode[(uint8_t)mode])();
-    (this->*map_func_instruct[(uint8_t)instr])();
-    RF.U = 1;
-}
+// Execute the instruction decoded by `Read`
+void CPU::RunInstr() { map_func_exec[opcode](*this); }
 
 void CPU::Print() {
     std::string ins;
@@ -452,7 +863,7 @@ void CPU::Print() {
     }
 
     ins += " A:" + Misc::hex(RA, 2) + " X:" + Misc::hex(RX, 2) +
-           " Y:" + Misc::hex(RY, 2) + " P:" + Misc::hex(RF.reg, 2) +
+           " Y:" + Misc::hex(RY, 2) + " P:" + Misc::hex(SyncF().reg, 2) +
            " SP:" + Misc::hex(SP, 2) + " TABS:" + Misc::hex(TABS, 4) +
            " CYC:" + std::to_string(cyc_count);
 
@@ -34,9 +34,9 @@ void CPU::BIT() {
     // fetch data from absolute address
     Byte val = disk->ReadMBus(TABS);
     // set flags
-    RF.SetZ(val & RA);
-    RF.SetN(val);
-    RF.V = (val & (1 << 6)) > 0;
+    LF.z = val & RA;
+    LF.n = val;
+    LF.v = val << 1;
 }
 
 // ----------------------------------------------------------------------------
@@ -64,13 +64,14 @@ void CPU::Reset() {
     SP = SP_INIT;
     TDAT = TABS = TREL = 0x0000;
 
-    RF.reg = 0b00100000;
+    LoadF(0b00100000);
     cycles = 8;
     cyc_count = 0;
 
     addr = 0xFFFF;
     mode = AddrMode::UNK;
     instr = Instruct::UNK;
+    opcode = 0x00;
     n_param = 0;
     lhs = 0;
     rhs = 0;
@@ -101,11 +102,13 @@ void CPU::IRQ() {
     RF.U = 1;
     RF.I = 1;
     // push status register to stack
-    disk->WriteMBus(stack_addr(SP--), RF.reg);
+    disk->WriteMBus(stack_addr(SP--), SyncF().reg);
     // read new program counter location from fixed address
     uint16_t lo = disk->ReadMBus(ADDR_IRQ);
     uint16_t hi = disk->ReadMBus(ADDR_IRQ + 1);
     PC = (hi << 8) | lo;
+    // account for the previous instruction before taking over `cycles`
+    cyc_count += cycles;
     cycles = 7;
 }
 
@@ -124,11 +127,13 @@ void CPU::NMI() {
     RF.U = 1;
     RF.I = 1;
     // push status register to stack
-    disk->WriteMBus(stack_addr(SP--), RF.reg);
+    disk->WriteMBus(stack_addr(SP--), SyncF().reg);
     // read new program counter location from fixed address
     uint16_t lo = disk->ReadMBus(ADDR_NMI);
     uint16_t hi = disk->ReadMBus(ADDR_NMI + 1);
     PC = (hi << 8) | lo;
+    // account for the previous instruction before taking over `cycles`
+    cyc_count += cycles;
     cycles = 8;
 }
 
@@ -144,7 +149,7 @@ void CPU::BRK() {
     RF.B = 1;
 
     // push status register to stack
-    disk->WriteMBus(stack_addr(SP--), RF.reg);
+    disk->WriteMBus(stack_addr(SP--), SyncF().reg);
 
     // set interrupt disable flag
     RF.B = 0;
@@ -159,7 +164,7 @@ void CPU::BRK() {
 void CPU::RTI() {
     // pull status register from stack
     SP++;
-    RF.reg = disk->ReadMBus(stack_addr(SP));
+    LoadF(disk->ReadMBus(stack_addr(SP)));
 
     // unset flags
     RF.B = 0;
@@ -186,8 +191,7 @@ void CPU::AND() {
     Byte val = disk->ReadMBus(TABS);
     RA &= val;
     // set flags
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Bitwise Logic AND (IMM mode).
@@ -196,8 +200,7 @@ void CPU::AND() {
 void CPU::ANI() {
     RA &= lhs;
     // set flags
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Bytewise Logical OR
@@ -210,8 +213,7 @@ void CPU::ORA() {
     RA |= val;
 
     // set flags
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Bytewise Logical OR (IMM mode).
@@ -221,8 +223,7 @@ void CPU::ORI() {
     RA |= lhs;
 
     // set flags
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Bitwise Logic XOR.
@@ -232,8 +233,7 @@ void CPU::ORI() {
 void CPU::EOR() {
     Byte val = disk->ReadMBus(TABS);
     RA ^= val;
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Bitwise Logic XOR (IMM mode).
@@ -241,8 +241,7 @@ void CPU::EOR() {
 // same as EOR, only for IMM mode
 void CPU::EOI() {
     RA ^= lhs;
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // ----------------------------------------------------------------------------
@@ -292,7 +291,7 @@ void CPU::PHP() {
     // save flags
     RF.B = 1;
     RF.U = 1;
-    disk->WriteMBus(stack_addr(SP--), RF.reg);
+    disk->WriteMBus(stack_addr(SP--), SyncF().reg);
     // reset flags
     RF.B = 0;
     RF.U = 0;
@@ -304,7 +303,7 @@ void CPU::PHP() {
 void CPU::PLP() {
     SP++;
     // pull status register from stack
-    RF.reg = disk->ReadMBus(stack_addr(SP));
+    LoadF(disk->ReadMBus(stack_addr(SP)));
     // reset flags
     RF.U = 1;
     // NOTE: added to align with the nestest
@@ -327,8 +326,7 @@ void CPU::PLA() {
     SP++;
     RA = disk->ReadMBus(stack_addr(SP));
     // set flags
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // ----------------------------------------------------------------------------
@@ -339,7 +337,7 @@ void CPU::PLA() {
 //
 // - pc = address if N = 1
 void CPU::BMI() {
-    if (RF.N == 1) {
+    if (LF.n & 0x80) {
         // add extra cycle
         cycles++;
         TABS = TREL + PC;
@@ -355,7 +353,7 @@ void CPU::BMI() {
 //
 // - PC = address if V == 0
 void CPU::BVC() {
-    if (RF.V == 0) {
+    if (!(LF.v & 0x80)) {
         // add extra cycle
         cycles++;
         // set absolute address
@@ -372,7 +370,7 @@ void CPU::BVC() {
 //
 // PC := address, if V = 1
 void CPU::BVS() {
-    if (RF.V == 1) {
+    if (LF.v & 0x80) {
         // add extra cycle
         cycles++;
         // set absolute address
@@ -389,7 +387,7 @@ void CPU::BVS() {
 //
 // - PC := address, if C == 0
 void CPU::BCC() {
-    if (RF.C == 0) {
+    if (LF.c == 0) {
         // add extra cycle
         cycles++;
         // set absolute address
@@ -406,7 +404,7 @@ void CPU::BCC() {
 //
 // - PC := address, if C == 1
 void CPU::BCS() {
-    if (RF.C == 1) {
+    if (LF.c != 0) {
         // add extra cycle
         cycles++;
         // set absolute address
@@ -423,7 +421,7 @@ void CPU::BCS() {
 //
 // PC := address, if Z == 0
 void CPU::BNE() {
-    if (RF.Z == 0) {
+    if (LF.z != 0) {
         // add extra cycle
         cycles++;
         // set absolute address
@@ -440,7 +438,7 @@ void CPU::BNE() {
 //
 // - PC := address, if Z == 1
 void CPU::BEQ() {
-    if (RF.Z == 1) {
+    if (LF.z == 0) {
         // add extra cycle
         cycles++;
         // set absolute address
@@ -457,7 +455,7 @@ void CPU::BEQ() {
 //
 // - PC := address, if N == 0
 void CPU::BPL() {
-    if (RF.N == 0) {
+    if (!(LF.n & 0x80)) {
         // add extra cycle
         cycles++;
         // set absolute address
@@ -501,12 +499,11 @@ void CPU::ADC() {
     // fetch data from absolute address
     uint16_t val = disk->ReadMBus(TABS);
     // R = A + M + C
-    uint16_t res = (uint16_t)RA + val + (uint16_t)RF.C;
+    uint16_t res = (uint16_t)RA + val + (uint16_t)LF.c;
     // set flags
-    RF.C = res > 0xFF;
-    RF.SetZ(res);
-    RF.SetN(res);
-    RF.V = ((~((uint16_t)RA ^ val) & ((uint16_t)RA ^ res)) & (1 << 7)) != 0;
+    LF.c = res > 0xFF;
+    SetNZ(res);
+    LF.v = ~((uint16_t)RA ^ val) & ((uint16_t)RA ^ res);
     // store result in accumulator
     RA = res & 0x00FF;
 }
@@ -516,13 +513,11 @@ void CPU::ADC() {
 // same as ADC, only for IMM mode
 void CPU::ADI() {
     // R = A + M + C
-    uint16_t res = (uint16_t)RA + (uint16_t)lhs + (uint16_t)RF.C;
+    uint16_t res = (uint16_t)RA + (uint16_t)lhs + (uint16_t)LF.c;
     // set flags
-    RF.C = res > 0xFF;
-    RF.SetZ(res);
-    RF.SetN(res);
-    RF.V = ((~((uint16_t)RA ^ (uint16_t)lhs) & ((uint16_t)RA ^ res)) &
-            (1 << 7)) != 0;
+    LF.c = res > 0xFF;
+    SetNZ(res);
+    LF.v = ~((uint16_t)RA ^ (uint16_t)lhs) & ((uint16_t)RA ^ res);
     // store result in accumulator
     RA = res & 0x00FF;
 }
@@ -536,12 +531,11 @@ void CPU::SBC() {
     // val := -M - 1
     uint16_t val = disk->ReadMBus(TABS) ^ 0x00FF;
     // R = A + (-M - 1) + C
-    uint16_t res = (uint16_t)RA + val + (uint16_t)RF.C;
+    uint16_t res = (uint16_t)RA + val + (uint16_t)LF.c;
     // set flags
-    RF.C = (res & 0xFF00) != 0;
-    RF.SetZ(res);
-    RF.SetN(res);
-    RF.V = ((res ^ (uint16_t)RA) & (res ^ val) & (1 << 7)) != 0;
+    LF.c = (res & 0xFF00) != 0;
+    SetNZ(res);
+    LF.v = (res ^ (uint16_t)RA) & (res ^ val);
     // store result in accumulator
     RA = res & 0x00FF;
 }
@@ -554,12 +548,11 @@ void CPU::SBI() {
     // val := -M - 1
     uint16_t val = lhs ^ 0x00FF;
     // R = A + (-M - 1) + C
-    uint16_t res = (uint16_t)RA + val + (uint16_t)RF.C;
+    uint16_t res = (uint16_t)RA + val + (uint16_t)LF.c;
     // set flags
-    RF.C = (res & 0xFF00) != 0;
-    RF.SetZ(res);
-    RF.SetN(res);
-    RF.V = ((res ^ (uint16_t)RA) & (res ^ val) & (1 << 7)) != 0;
+    LF.c = (res & 0xFF00) != 0;
+    SetNZ(res);
+    LF.v = (res ^ (uint16_t)RA) & (res ^ val);
     // store result in accumulator
     RA = res & 0x00FF;
 }
@@ -573,12 +566,11 @@ void CPU::LSR() {
     // fetch data from absolute address
     uint16_t val = disk->ReadMBus(TABS);
     // set C flag
-    RF.C = (val & 0x0001) != 0;
+    LF.c = (val & 0x0001) != 0;
     // shift right
     val >>= 1;
     // set flags
-    RF.SetZ(val);
-    RF.SetN(val);
+    SetNZ(val);
     // write data to absolute address
     disk->WriteMBus(TABS, val & 0x00FF);
 }
@@ -589,12 +581,11 @@ void CPU::LRA() {
     // fetch data from absolute address
     uint16_t val = RA;
     // set C flag
-    RF.C = (val & 0x0001) != 0;
+    LF.c = (val & 0x0001) != 0;
     // shift right
     val >>= 1;
     // set flags
-    RF.SetZ(val);
-    RF.SetN(val);
+    SetNZ(val);
     // store result in accumulator
     RA = val & 0x00FF;
 }
@@ -607,9 +598,8 @@ void CPU::ASL() {
     // fetch data from absolute address and shift left
     uint16_t val = disk->ReadMBus(TABS) << 1;
     // set flags
-    RF.C = (val & 0xFF00) != 0;
-    RF.SetZ(val);
-    RF.SetN(val);
+    LF.c = (val & 0xFF00) != 0;
+    SetNZ(val);
     // write data to absolute address
     disk->WriteMBus(TABS, val & 0x00FF);
 }
@@ -620,9 +610,8 @@ void CPU::ALA() {
     // fetch data from accumulator and shift left
     uint16_t val = RA << 1;
     // set flags
-    RF.C = (val & 0xFF00) != 0;
-    RF.SetZ(val);
-    RF.SetN(val);
+    LF.c = (val & 0xFF00) != 0;
+    SetNZ(val);
     // store result in accumulator
     RA = val & 0x00FF;
 }
@@ -635,11 +624,10 @@ void CPU::ALA() {
 void CPU::ROL() {
     // fetch data from absolute address, rotate left, and set C flag
     // NOTE: C flag is set to the old bit 7
-    uint16_t val = disk->ReadMBus(TABS) << 1 | (uint16_t)RF.C;
+    uint16_t val = disk->ReadMBus(TABS) << 1 | (uint16_t)LF.c;
     // set flags
-    RF.C = (val & 0xFF00) != 0;
-    RF.SetZ(val);
-    RF.SetN(val);
+    LF.c = (val & 0xFF00) != 0;
+    SetNZ(val);
     // write data to absolute address
     disk->WriteMBus(TABS, val & 0x00FF);
 }
@@ -648,11 +636,10 @@ void CPU::ROL() {
 // Same as ROL except that the result is stored in the accumulator
 void CPU::RLA() {
     // fetch from accumulator
-    uint16_t val = RA << 1 | (uint16_t)RF.C;
+    uint16_t val = RA << 1 | (uint16_t)LF.c;
     // set flags
-    RF.C = (val & 0xFF00) != 0;
-    RF.SetZ(val);
-    RF.SetN(val);
+    LF.c = (val & 0xFF00) != 0;
+    SetNZ(val);
     // store result in accumulator
     RA = val & 0x00FF;
 }
@@ -665,11 +652,10 @@ void CPU::ROR() {
     // fetch data from absolute address
     Byte val = disk->ReadMBus(TABS);
     // rotate right
-    uint16_t res = (val >> 1) | (RF.C << 7);
+    uint16_t res = (val >> 1) | (LF.c << 7);
     // set flags
-    RF.C = (val & 0x01) != 0;
-    RF.SetZ(res);
-    RF.SetN(res);
+    LF.c = (val & 0x01) != 0;
+    SetNZ(res);
     // write data to absolute address
     disk->WriteMBus(TABS, res & 0x00FF);
 }
@@ -680,11 +666,10 @@ void CPU::RRA() {
     // fetch data from absolute address
     Byte val = RA;
     // rotate right
-    uint16_t res = (val >> 1) | (RF.C << 7);
+    uint16_t res = (val >> 1) | (LF.c << 7);
     // set flags
-    RF.C = (val & 0x01) != 0;
-    RF.SetZ(res);
-    RF.SetN(res);
+    LF.c = (val & 0x01) != 0;
+    SetNZ(res);
     // store result in accumulator
     RA = res & 0x00FF;
 }
@@ -714,8 +699,7 @@ void CPU::STX() { disk->WriteMBus(TABS, RX); }
 // - Flags: N, Z
 void CPU::TXA() {
     RA = RX;
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Transfer Y Register to Accumulator.
@@ -724,8 +708,7 @@ void CPU::TXA() {
 // - Flags: N, Z
 void CPU::TYA() {
     RA = RY;
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Transfer X Register to Stack Pointer.
@@ -739,8 +722,7 @@ void CPU::TXS() { SP = RX; }
 // - Flags: N, Z
 void CPU::LDY() {
     RY = disk->ReadMBus(TABS);
-    RF.SetZ(RY);
-    RF.SetN(RY);
+    SetNZ(RY);
 }
 
 // Instruction: Load The Y Register (IMM mode).
@@ -748,8 +730,7 @@ void CPU::LDY() {
 // same as LDY, only for IMM mode
 void CPU::LYI() {
     RY = lhs;
-    RF.SetZ(RY);
-    RF.SetN(RY);
+    SetNZ(RY);
 }
 
 // Instruction: Load The Accumulator.
@@ -758,8 +739,7 @@ void CPU::LYI() {
 // - Flags: N, Z
 void CPU::LDA() {
     RA = disk->ReadMBus(TABS);
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Load The Accumulator (IMM mode).
@@ -767,8 +747,7 @@ void CPU::LDA() {
 // same as LDA, only for IMM mode
 void CPU::LAI() {
     RA = lhs;
-    RF.SetZ(RA);
-    RF.SetN(RA);
+    SetNZ(RA);
 }
 
 // Instruction: Load The X Register.
@@ -777,8 +756,7 @@ void CPU::LAI() {
 // - Flags: N, Z
 void CPU::LDX() {
     RX = disk->ReadMBus(TABS);
-    RF.SetZ(RX);
-    RF.SetN(RX);
+    SetNZ(RX);
 }
 
 // Instruction: Load The X Register (IMM mode).
@@ -786,8 +764,7 @@ void CPU::LDX() {
 // same as LDX, only for IMM mode
 void CPU::LXI() {
     RX = lhs;
-    RF.SetZ(RX);
-    RF.SetN(RX);
+    SetNZ(RX);
 }
 
 // Instruction: Transfer Accumulator to Y Register.
@@ -796,8 +773,7 @@ void CPU::LXI() {
 // - Flags: N, Z
 void CPU::TAY() {
     RY = RA;
-    RF.SetZ(RY);
-    RF.SetN(RY);
+    SetNZ(RY);
 }
 
 // Instruction: Transfer Accumulator to X Register
@@ -806,8 +782,7 @@ void CPU::TAY() {
 // - Flags: N, Z
 void CPU::TAX() {
     RX = RA;
-    RF.SetZ(RX);
-    RF.SetN(RX);
+    SetNZ(RX);
 }
 
 // Instruction: Transfer Stack Pointer to X Register.
@@ -816,8 +791,7 @@ void CPU::TAX() {
 // - Flags: N, Z
 void CPU::TSX() {
     RX = SP;
-    RF.SetZ(RX);
-    RF.SetN(RX);
+    SetNZ(RX);
 }
 
 // ----------------------------------------------------------------------------
@@ -834,9 +808,8 @@ void CPU::CPY() {
     Byte val = disk->ReadMBus(TABS);
     uint16_t tmp = (uint16_t)RY - (uint16_t)val;
     // set flags
-    RF.C = RY >= val;
-    RF.SetZ(tmp);
-    RF.SetN(tmp);
+    LF.c = RY >= val;
+    SetNZ(tmp);
 }
 
 // Instruction: Compare Y Register (IMM mode).
@@ -846,9 +819,8 @@ void CPU::CYI() {
     // fetch data from absolute address
     uint16_t tmp = (uint16_t)RY - (uint16_t)lhs;
     // set flags
-    RF.C = RY >= lhs;
-    RF.SetZ(tmp);
-    RF.SetN(tmp);
+    LF.c = RY >= lhs;
+    SetNZ(tmp);
 }
 
 // Instruction: Compare Accumulator.
@@ -861,9 +833,8 @@ void CPU::CMP() {
     Byte val = disk->ReadMBus(TABS);
     uint16_t tmp = (uint16_t)RA - (uint16_t)val;
     // set flags
-    RF.C = RA >= val;
-    RF.SetZ(tmp);
-    RF.SetN(tmp);
+    LF.c = RA >= val;
+    SetNZ(tmp);
 }
 
 // Instruction: Compare Accumulator (IMM mode).
@@ -873,9 +844,8 @@ void CPU::CMI() {
     // fetch data from absolute address
     uint16_t tmp = (uint16_t)RA - (uint16_t)lhs;
     // set flags
-    RF.C = RA >= lhs;
-    RF.SetZ(tmp);
-    RF.SetN(tmp);
+    LF.c = RA >= lhs;
+    SetNZ(tmp);
 }
 
 // Instruction: Compare X Register.
@@ -888,9 +858,8 @@ void CPU::CPX() {
     Byte val = disk->ReadMBus(TABS);
     uint16_t tmp = (uint16_t)RX - (uint16_t)val;
     // set flags
-    RF.C = RX >= val;
-    RF.SetZ(tmp);
-    RF.SetN(tmp);
+    LF.c = RX >= val;
+    SetNZ(tmp);
 }
 
 // Instruction: Compare X Register (IMM mode).
@@ -900,9 +869,8 @@ void CPU::CXI() {
     // fetch data from absolute address
     uint16_t tmp = (uint16_t)RX - (uint16_t)lhs;
     // set flags
-    RF.C = RX >= lhs;
-    RF.SetZ(tmp);
-    RF.SetN(tmp);
+    LF.c = RX >= lhs;
+    SetNZ(tmp);
 }
 
 // ----------------------------------------------------------------------------
@@ -919,8 +887,7 @@ void CPU::DEC() {
     // decrement
     val--;
     // set flags
-    RF.SetZ(val);
-    RF.SetN(val);
+    SetNZ(val);
     // write data to absolute address
     disk->WriteMBus(TABS, val);
 }
@@ -935,8 +902,7 @@ void CPU::INC() {
     // increment
     val++;
     // set flags
-    RF.SetZ(val);
-    RF.SetN(val);
+    SetNZ(val);
     // write data to absolute address
     disk->WriteMBus(TABS, val);
 }
@@ -947,8 +913,7 @@ void CPU::INC() {
 // - Flags: N, Z
 void CPU::DEY() {
     RY--;
-    RF.SetZ(RY);
-    RF.SetN(RY);
+    SetNZ(RY);
 }
 
 // Instruction: Increment Y Register.
@@ -957,8 +922,7 @@ void CPU::DEY() {
 // - Flags: N, Z
 void CPU::INY() {
     RY++;
-    RF.SetZ(RY);
-    RF.SetN(RY);
+    SetNZ(RY);
 }
 
 // Instruction: Decrement X Register.
@@ -967,8 +931,7 @@ void CPU::INY() {
 // - Flags: N, Z
 void CPU::DEX() {
     RX--;
-    RF.SetZ(RX);
-    RF.SetN(RX);
+    SetNZ(RX);
 }
 
 // Instruction: Increment X Register.
@@ -977,8 +940,7 @@ void CPU::DEX() {
 // - Flags: N, Z
 void CPU::INX() {
     RX++;
-    RF.SetZ(RX);
-    RF.SetN(RX);
+    SetNZ(RX);
 }
 
 // ----------------------------------------------------------------------------
@@ -988,7 +950,7 @@ void CPU::INX() {
 // Instruction: Clear Carry Flag
 //
 // - C = 0
-void CPU::CLC() { RF.C = 0; }
+void CPU::CLC() { LF.c = 0; }
 
 // Instruction: Clear Decimal Flag.
 //
@@ -998,7 +960,7 @@ void CPU::CLD() { RF.D = 0; }
 // Instruction: Clear Overflow Flag.
 //
 // - V := 0
-void CPU::CLV() { RF.V = 0; }
+void CPU::CLV() { LF.v = 0; }
 
 // Instruction: Disable Interrupts / Clear Interrupt Flag.
 //
@@ -1008,7 +970,7 @@ void CPU::CLI() { RF.I = 0; }
 // Instruction: Set Carry Flag.
 //
 // - C = 1
-void CPU::SEC() { RF.C = 1; }
+void CPU::SEC() { LF.c = 1; }
 
 // Instruction: Set Interrupt Flag / Enable Interrupts.
 //
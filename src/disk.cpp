@@ -2,26 +2,45 @@
 #include "const.hpp"
 #include "neshdr.hpp"
 
-#include <fstream>
+#include <cstring>
 #include <iostream>
 
-// Constant $4E $45 $53 $1A (ASCII "NES" followed by MS-DOS end-of-file)
-static constexpr char NES_NAME[4] = {0x4E, 0x45, 0x53, 0x1A};
-
 // ----------------------------------------------------------------------------
 // Disk Class
 // ----------------------------------------------------------------------------
 
 // Constructor
-Disk::Disk()
-    : ram(kRAMSize, 0), vrm(kVRAMSize), pal(kPaletteSize), prg(0), chr(0) {
-    // clear PPU memory
-    std::fill(ram.begin(), ram.end(), 0);
+Disk::Disk() {
+    // clear memory
+    std::fill(std::begin(ram), std::end(ram), 0);
+    std::fill(std::begin(vrm), std::end(vrm), 0);
+    std::fill(std::begin(pal), std::end(pal), 0);
+    for (uint32_t i = 0; i < kOAMSize; i++)
+        oam.Write(i, 0);
+    pal_dirty = true;
+    oam_dma = false;
+    // PPU registers, fine X scroll and write toggle included, are 0 at power-up
+    std::memset(&pram, 0, sizeof(pram));
 
     // clear cartridge memory
+    prg = chr = nullptr;
+    prg_ram = chr_ram = nullptr;
+    std::fill(std::begin(chr_rd), std::end(chr_rd), nullptr);
+    std::fill(std::begin(chr_wr), std::end(chr_wr), nullptr);
+    tiles = nullptr;
+    tiles_ram = tile_ok = nullptr;
+    std::fill(std::begin(tile_rd), std::end(tile_rd), nullptr);
     prg_kb = 0;
     chr_kb = 0;
-    mirror = MirrorMode::SINGLE;
+    MapNT(MirrorMode::SINGLE);
+    std::fill(std::begin(prg_rev), std::end(prg_rev), 0);
+
+    // main bus: 2KB RAM mirrored up to 0x1FFF, I/O up to 0x40FF, open bus
+    // until a cartridge is attached
+    MapMBus(0x00, 0x20, ram, ram, kRAMSize);
+    MapMBus(0x20, 0x20, PageIO::PPU);
+    MapMBus(0x40, 0x01, PageIO::APU);
+    MapMBus(0x41, 0xBF, PageIO::NONE);
 }
 
 // Destructor
@@ -30,8 +49,13 @@ Disk::~Disk() {}
 void Disk::Print() {
     std::cout << "PRG-ROM:" << prg_kb << "KB; CHR-ROM:" << chr_kb << "KB"
               << std::endl;
+    std::cout << "Mapper:" << +(uint8_t)mapper.id << std::endl;
     std::cout << "Mirroring:";
     switch (mirror) {
+    case MirrorMode::SINGLE:
+    case MirrorMode::SINGLE_HI:
+        std::cout << "Single" << std::endl;
+        break;
     case MirrorMode::HORIZ:
         std::cout << "Horizontal" << std::endl;
         break;
@@ -48,57 +72,49 @@ void Disk::Print() {
 
 void Disk::Attach(const std::string &cart) {
 
-    std::ifstream file(cart, std::ios::binary);
-
-    NesHdr header;
-
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + cart);
-    }
-
-    if (!file.read((char *)&header, sizeof(NesHdr)) ||
-        std::memcmp(header.name, NES_NAME, 4) != 0) {
-        throw std::runtime_error("Failed to read header");
-    }
-
-    // If a "trainer" exists we just need to read past it before we get to the
-    // good stuff
-    if (header.trainer)
-        file.seekg(512, std::ios_base::cur);
+    rom = Rom::Load(cart);
+    const NesHdr &header = rom->header;
 
     // determine mirroring mode
     if (header.four) {
-        mirror = MirrorMode::FOUR;
+        MapNT(MirrorMode::FOUR);
     } else if (header.vertical) {
-        mirror = MirrorMode::VERT;
+        MapNT(MirrorMode::VERT);
     } else {
-        mirror = MirrorMode::HORIZ;
+        MapNT(MirrorMode::HORIZ);
     }
 
     // update PRG/CHR size
-    prg_kb = MAX(1, header.n_chunk_prg) * 16; // 16kb chunks
-    chr_kb = MAX(1, header.n_chunk_chr) * 8;  // 8kb chunks
+    prg_kb = rom->prg_size / 1024;
+    chr_kb = rom->chr_size ? rom->chr_size / 1024 : 8;
 
-    // restrict for now:
-    // - 32KB PRG-ROM
-    // -  8KB CHR-ROM
-    if (prg_kb > 32) {
-        throw std::runtime_error(
-            "Unsupported PRG-ROM size: " + std::to_string(prg_kb) + "KB");
+    const uint8_t id = (header.mapper_hi << 4) | header.mapper_lo;
+    if (!Mapper::Supported(id)) {
+        throw std::runtime_error("Unsupported mapper: " + std::to_string(id));
     }
-    // if (chr_kb > 8) {
-    //     throw std::runtime_error(
-    //         "Unsupported CHR-ROM size: " + std::to_string(chr_kb) + "KB");
-    // }
-
-    // read prg rom
-    prg.resize(prg_kb * 1024);
-    chr.resize(chr_kb * 1024);
 
-    if (!file.read((char *)prg.data(), prg.size())) {
-        throw std::runtime_error("Failed to read prg rom");
-    }
-    if (!file.read((char *)chr.data(), chr.size())) {
-        throw std::runtime_error("Failed to read chr rom");
+    // ROM is shared, RAM is per instance: CHR-RAM brings its decoded tiles
+    // (32KB) and their flags along
+    banks.assign(0x2000 + (rom->chr_size ? 0 : 0x2000 + 0x8000 + 0x0200), 0);
+    prg = rom->prg;
+    prg_ram = banks.data();
+    if (rom->chr_size) {
+        chr = rom->chr;
+        chr_ram = nullptr;
+        tiles = rom->tiles.data();
+        tiles_ram = tile_ok = nullptr;
+    } else {
+        chr = chr_ram = banks.data() + 0x2000;
+        tiles = tiles_ram = banks.data() + 0x4000;
+        tile_ok = banks.data() + 0xC000;
     }
+
+    // 8KB PRG-RAM; PRG-ROM and CHR banks are up to the mapper
+    MapMBus(0x60, 0x20, prg_ram, prg_ram, 0x2000);
+    mapper.id = (MapperId)id;
+    mapper.Reset(*this);
+
+    // the whole PRG window has new contents
+    for (uint32_t &rev : prg_rev)
+        rev++;
 }
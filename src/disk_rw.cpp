@@ -1,5 +1,10 @@
 #include "disk.hpp"
 
+#include <algorithm>
+#include <cstring>
+
+#include "chr.hpp"
+
 // ----------------------------------------------------------------------------
 // Address Ranges
 // ----------------------------------------------------------------------------
@@ -57,37 +62,8 @@
 // TODO: implement read / write effects
 // https://github.com/quackenbush/nestalgia/blob/master/docs/ppu/SKINNY.TXT
 //
-enum class AddrRangeMBus : uint8_t {
-    RG_NONE = 0, // invalid
-
-    // RAM space
-    RG_2000 = 1, // 0x0000 - 0x1fff, main RAM
-    RG_4000 = 2, // 0x2000 - 0x3fff, PPU registers
-    RG_4020 = 3, // 0x4000 - 0x401f, APU + OAMDMA
-
-    // cartridge space
-    RG_6000 = 4, // 0x4020 - 0x5fff, expansion ROM
-    RG_8000 = 5, // 0x6000 - 0x7fff, expansion RAM
-    RG_G000 = 6, // 0x8000 - 0xffff, PRG-ROM
-};
-
-static inline constexpr AddrRangeMBus addr_range_cpu(const uint16_t &addr) {
-    if (addr < 0x2000) {
-        return AddrRangeMBus::RG_2000;
-    } else if (addr < 0x4000) {
-        return AddrRangeMBus::RG_4000;
-    } else if (addr < 0x4020) {
-        return AddrRangeMBus::RG_4020;
-    } else if (addr < 0x6000) {
-        return AddrRangeMBus::RG_6000;
-    } else if (addr < 0x8000) {
-        return AddrRangeMBus::RG_8000;
-    } else if (addr <= 0xFFFF) {
-        return AddrRangeMBus::RG_G000;
-    } else {
-        return AddrRangeMBus::RG_NONE;
-    }
-}
+// The main bus is dispatched through the page table of `Disk`, see
+// `Disk::MapMBus`: plain memory is accessed directly, the rest by `PageIO`.
 
 // Address Range for PPU:
 //
@@ -214,8 +190,9 @@ Byte Disk::ReadPRam(const uint16_t &addr) {
         break;
     case 0x0003: // OAMADDR: not readable
         break;
-    case 0x0004: // OAMDATA: read directly
-        data = pram.oamdata;
+    case 0x0004: // OAMDATA: reads do not increment OAMADDR
+        data = oam.Read(pram.oamaddr);
+        break;
     case 0x0005: // PPUSCROLL: not readable
         break;
     case 0x0006: // PPUADDR: not readable
@@ -251,6 +228,9 @@ void Disk::WritePRam(const uint16_t &addr, const Byte &data) {
         pram.t.nty = pram.ctrl.nty;
         break;
     case 0x0001: // PPUMASK
+        // greyscale (bit 0) or emphasis (bits 5 - 7) change the colors
+        if ((pram.mask.reg ^ data) & 0xE1)
+            pal_dirty = true;
         pram.mask.reg = data;
         break;
     case 0x0002: // PPUSTATUS: not writable
@@ -260,6 +240,7 @@ void Disk::WritePRam(const uint16_t &addr, const Byte &data) {
         break;
     case 0x0004: // OAMDATA
         pram.oamdata = data;
+        oam.Write(pram.oamaddr++, data);
         break;
     case 0x0005: // PPUSCROLL
         // data contains the scroll offsets in pixel, which can be split into
@@ -321,128 +302,156 @@ void Disk::WritePRam(const uint16_t &addr, const Byte &data) {
     }
 }
 
-// TODO: log read access
-Byte Disk::ReadMBus(const uint16_t &addr) {
-    AddrRangeMBus rg = addr_range_cpu(addr);
-    switch (rg) {
-    case AddrRangeMBus::RG_2000:
-        // NOTE: 2KB RAM
-        return ram[addr & 0x07FF];
-    case AddrRangeMBus::RG_4000:
+// Map `n` pages of the main bus starting from page `first` to `rd` for reads
+// and `wr` for writes, mirrored every `size` bytes. `wr` is either the same
+// memory as `rd`, or nullptr for read-only memory, whose writes go to `io`.
+void Disk::MapMBus(const uint8_t &first, const uint16_t &n, const Byte *rd,
+                   Byte *wr, const uint32_t &size, const PageIO &io) {
+    for (uint16_t i = 0; i < n; i++) {
+        const uint32_t offset = ((uint32_t)i << 8) % size;
+        page_rd[first + i] = rd + offset;
+        page_wr[first + i] = wr ? wr + offset : nullptr;
+        page_io[first + i] = io;
+    }
+}
+
+// Map the 8KB bank `bank` of PRG-ROM (mirrored) to the slot `slot` of the PRG
+// window, i.e. 0x8000 + slot * 0x2000.
+//
+// Bumps the revision of the slot if its contents change.
+void Disk::MapPRG(const uint8_t &slot, const uint32_t &bank) {
+    const Byte *mem = prg + (bank % (prg_kb / 8)) * 0x2000;
+    const uint8_t first = 0x80 + slot * 0x20;
+    if (page_rd[first] == mem)
+        return;
+    MapMBus(first, 0x20, mem, nullptr, 0x2000, PageIO::MAPPER);
+    prg_rev[slot]++;
+}
+
+// Map `n` pages of the main bus starting from page `first` to the handler `io`
+void Disk::MapMBus(const uint8_t &first, const uint16_t &n, const PageIO &io) {
+    for (uint16_t i = 0; i < n; i++) {
+        page_rd[first + i] = nullptr;
+        page_wr[first + i] = nullptr;
+        page_io[first + i] = io;
+    }
+}
+
+// Read 1 byte from a page of the main bus not backed by memory
+Byte Disk::ReadIO(const uint16_t &addr) {
+    switch (page_io[addr >> 8]) {
+    case PageIO::PPU:
+        if (sync)
+            sync();
         // NOTE: PPU registers are mirrored every 8 bytes i.e.
         // 0x2000 == 0x2008 == 0x2010 == ...
         // 0x2001 == 0x2009 == 0x2011 == ...
         // ...
         return ReadPRam(addr & 0x0007);
-    case AddrRangeMBus::RG_4020:
-        return ram[addr];
-    case AddrRangeMBus::RG_6000:
-        // not implemented
-        break;
-    case AddrRangeMBus::RG_8000:
-        // not implemented
-        break;
-    case AddrRangeMBus::RG_G000:
-        if (prg_kb < 32) {
-            // 16KB PRG-ROM
-            return prg[(addr - 0x8000) & 0x3FFF];
-        } else {
-            // 32KB PRG-ROM
-            // TODO: above 32KB?
-            return prg[addr - 0x8000];
-        }
+    case PageIO::APU:
+        // APU and I/O registers, expansion ROM: not implemented
+        return 0;
     default:
-        break;
+        // open bus, not implemented
+        return 0;
     }
-    return 0;
 }
 
-// TODO: log write access
-void Disk::WriteMBus(const uint16_t &addr, const Byte &data) {
-    AddrRangeMBus rg = addr_range_cpu(addr);
-    switch (rg) {
-    case AddrRangeMBus::RG_2000:
-        // NOTE: 2KB RAM
-        ram[addr & 0x07FF] = data;
-        break;
-    case AddrRangeMBus::RG_4000:
+// Write 1 byte to a page of the main bus not backed by (writable) memory
+void Disk::WriteIO(const uint16_t &addr, const Byte &data) {
+    switch (page_io[addr >> 8]) {
+    case PageIO::PPU:
+        if (sync)
+            sync();
         // NOTE: PPU registers are mirrored every 8 bytes i.e.
         // 0x2000 == 0x2008 == 0x2010 == ...
         // 0x2001 == 0x2009 == 0x2011 == ...
         // ...
         WritePRam(addr & 0x0007, data);
         break;
+    case PageIO::APU:
+        if (addr == 0x4014) {
+            if (sync)
+                sync();
+            OAMDMA(data);
+        }
+        break;
+    case PageIO::MAPPER:
+        // bank switches and IRQ settings take effect from now on
+        if (sync)
+            sync();
+        mapper.Write(*this, addr, data);
+        break;
     default:
         break;
     }
 }
 
+// OAM DMA (0x4014): copy the page `page` of the main bus into OAM, starting at
+// OAMADDR and wrapping around.
+//
+// The 256 reads / writes happen at once, the CPU being halted meanwhile
+// anyway: the page is staged with OAMADDR at its start, then spread into the
+// arrays of `OAM`. The stall is up to the scheduler, see `oam_dma`.
+void Disk::OAMDMA(const Byte &page) {
+    pram.oamdma = page;
+
+    alignas(64) Byte io[256];
+    const Byte *src = page_rd[page];
+    if (!src) {
+        // registers, open bus: not worth a fast path
+        for (uint16_t i = 0; i < 256; i++)
+            io[i] = ReadIO((page << 8) | i);
+        src = io;
+    }
+
+    alignas(64) Byte mem[256];
+    const uint8_t at = pram.oamaddr;
+    std::memcpy(mem + at, src, 256 - at);
+    std::memcpy(mem, src + 256 - at, at);
+    oam.Load(mem);
+    oam_dma = true;
+}
+
 // ----------------------------------------------------------------------------
 // PPU Bus Access
 // ----------------------------------------------------------------------------
 
-// Map the address to the VRAM based on the mirroring mode
-//
-// The input address `addr` MUST be in the range of 0x0000 - 0x0FFF.
+// Map the logical nametables to the VRAM based on the mirroring mode
 //
-// - 4-screen mode: the address is not mirrored.
-// - access to Logical NT 0 and NT 3 will not be mirrored, whatever the mode is
+// - 4-screen mode: the nametables are not mirrored.
+// - Logical NT 0 and NT 3 are not mirrored, whatever the mode is
 // - Horizontal mode: NT 1 and NT 2 are mirrored to NT 0 and NT 3 respectively.
-//   - NT1: 0x0400 - 0x07FF ==> 0x0000 - 0x03FF:
-//     - AND 0x03FF
-//   - NT2: 0x0800 - 0x0BFF ==> 0x0C00 - 0x0FFF
-//     - src: 1000 0000 0000, 1011 1111 1111
-//     - +OR: 0100 0000 0000, 0100 0000 0000 (0x0400)
-//     - dst: 1100 0000 0000, 1111 1111 1111
 // - Vertical mode: NT 1 and NT 2 are mirrored to NT 3 and NT 0 respectively.
-//   - NT1: 0x0400 - 0x07FF ==> 0x0C00 - 0x0FFF
-//     - src: 0100 0000 0000, 0111 1111 1111
-//     - +OR: 1000 0000 0000, 1000 0000 0000 (0x0800)
-//     - dst: 1100 0000 0000, 1111 1111 1111
-//   - NT2: 0x0800 - 0x0BFF ==> 0x0000 - 0x03FF
-//     - AND 0x03FF
-static inline uint16_t vram_addr_mapper(const uint16_t &addr,
-                                        const MirrorMode &mode) {
-    switch (mode) {
-    case MirrorMode::SINGLE:
-        return addr & 0x03FF;
-    case MirrorMode::FOUR:
-        return addr;
-    case MirrorMode::HORIZ:
-        if (addr < 0x0400) {
-            return addr;
-        } else if (addr < 0x0800) {
-            return addr & 0x03FF;
-        } else if (addr < 0x0C00) {
-            return addr | 0x0400;
-        } else {
-            return addr;
-        }
-    case MirrorMode::VERT:
-        if (addr < 0x0400) {
-            return addr;
-        } else if (addr < 0x0800) {
-            return addr | 0x0800;
-        } else if (addr < 0x0C00) {
-            return addr & 0x03FF;
-        } else {
-            return addr;
-        }
-    default:
-        throw std::runtime_error("invalid mirror mode");
-    }
+// - Single-screen mode: all of them are mirrored to NT 0.
+//
+// NOTE: MUST be called again whenever `mirror` changes.
+void Disk::MapNT(const MirrorMode &mode) {
+    static constexpr uint16_t kOffset[5][4] = {
+        {0x0000, 0x0000, 0x0000, 0x0000}, // SINGLE
+        {0x0000, 0x0000, 0x0C00, 0x0C00}, // HORIZ
+        {0x0000, 0x0C00, 0x0000, 0x0C00}, // VERT
+        {0x0000, 0x0400, 0x0800, 0x0C00}, // FOUR
+        {0x0C00, 0x0C00, 0x0C00, 0x0C00}, // SINGLE_HI
+    };
+    mirror = mode;
+    for (int i = 0; i < 4; i++)
+        nt[i] = vrm + kOffset[(uint8_t)mode][i];
 }
 
-static inline Byte read_ppu_vram(const uint16_t &addr, const Mem &vram,
-                                 const MirrorMode &mode) {
-    const uint16_t mapped_addr = vram_addr_mapper(addr, mode);
-    return vram[mapped_addr];
+// Map the 1KB bank `bank` of CHR memory (mirrored) to the slot `slot` of the
+// pattern tables, i.e. 0x0000 + slot * 0x0400.
+void Disk::MapCHR(const uint8_t &slot, const uint32_t &bank) {
+    const uint32_t offset = (bank % chr_kb) * 0x0400;
+    chr_rd[slot] = chr + offset;
+    chr_wr[slot] = chr_ram ? chr_ram + offset : nullptr;
+    tile_rd[slot] = tiles + offset * 4;
 }
 
-static inline void write_ppu_vram(const uint16_t &addr, const Byte &data,
-                                  Mem &vram, const MirrorMode &mode) {
-    const uint16_t mapped_addr = vram_addr_mapper(addr, mode);
-    vram[mapped_addr] = data;
+// Decode a tile of CHR-RAM (0 - 511) into `tiles_ram`, see `Chr`
+void Disk::DecodeTile(const uint16_t &tile) {
+    Chr::decode_tile(chr_ram + tile * 16, tiles_ram + tile * 64);
+    tile_ok[tile] = true;
 }
 
 // Map the address to the palette table based on the mirroring mechanism.
@@ -458,13 +467,13 @@ static inline uint16_t pal_addr_mapper(const uint16_t &addr) {
     }
 }
 
-static inline Byte read_ppu_pal(const uint16_t &addr, const Mem &mem) {
+static inline Byte read_ppu_pal(const uint16_t &addr, const Byte *mem) {
     const uint16_t mapped_addr = pal_addr_mapper(addr);
     return mem[mapped_addr];
 }
 
 static inline void write_ppu_pal(const uint16_t &addr, const Byte &data,
-                                 Mem &mem) {
+                                 Byte *mem) {
     const uint16_t mapped_addr = pal_addr_mapper(addr);
     mem[mapped_addr] = data;
 }
@@ -473,13 +482,12 @@ Byte Disk::ReadPBus(const uint16_t &addr) {
     AddrRangePBus rg = addr_range_ppu(addr);
     switch (rg) {
     case AddrRangePBus::RG_1000:
-        return chr[addr];
     case AddrRangePBus::RG_2000:
-        return chr[addr];
+        return chr_rd[addr >> 10][addr & 0x03FF];
     case AddrRangePBus::RG_3000:
-        return read_ppu_vram(addr & 0x0FFF, vrm, mirror);
+        return ReadNT(addr);
     case AddrRangePBus::RG_3F00:
-        return read_ppu_vram((addr - 0x1000) & 0x0FFF, vrm, mirror);
+        return ReadNT(addr);
     case AddrRangePBus::RG_3F20:
         return read_ppu_pal(addr & 0x001F, pal);
     case AddrRangePBus::RG_4000:
@@ -493,22 +501,28 @@ void Disk::WritePBus(const uint16_t &addr, const Byte &data) {
     AddrRangePBus rg = addr_range_ppu(addr);
     switch (rg) {
     case AddrRangePBus::RG_1000:
-        chr[addr] = data;
-        break;
     case AddrRangePBus::RG_2000:
-        chr[addr] = data;
+        // writes to CHR-ROM are dropped
+        if (chr_wr[addr >> 10]) {
+            Byte *mem = chr_wr[addr >> 10];
+            mem[addr & 0x03FF] = data;
+            // the tile is decoded again on its next read, in any slot
+            tile_ok[(mem - chr_ram + (addr & 0x03FF)) >> 4] = false;
+        }
         break;
     case AddrRangePBus::RG_3000:
-        write_ppu_vram(addr & 0x0FFF, data, vrm, mirror);
+        WriteNT(addr, data);
         break;
     case AddrRangePBus::RG_3F00:
-        write_ppu_vram((addr - 0x1000) & 0x0FFF, data, vrm, mirror);
+        WriteNT(addr, data);
         break;
     case AddrRangePBus::RG_3F20:
         write_ppu_pal(addr & 0x001F, data, pal);
+        pal_dirty = true;
         break;
     case AddrRangePBus::RG_4000:
         write_ppu_pal(addr & 0x001F, data, pal);
+        pal_dirty = true;
         break;
     default:
         break;
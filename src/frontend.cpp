@@ -0,0 +1,175 @@
+#include "frontend.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// period of the frame rate shown in the title
+static constexpr std::chrono::seconds kFPSPeriod(1);
+
+// rewind history: a snapshot every 2 frames, in a 16MB ring (a few minutes
+// at least, see bench/bench_state.cpp)
+static constexpr size_t kRewindSize = 16 * 1024 * 1024;
+static constexpr uint32_t kRewindInterval = 2;
+
+// Constructor & Destructor
+Frontend::Frontend() : rewind(kRewindSize, kRewindInterval) {
+    window.create(sf::VideoMode(kScreenW, kScreenH), "MyNES",
+                  sf::Style::Titlebar | sf::Style::Close);
+    window.setVerticalSyncEnabled(true);
+    fps = 0;
+    rewinding = false;
+}
+Frontend::~Frontend() {}
+
+// Send an event to the emulation thread, which drains the queue every frame
+void Frontend::send(const InputEvent &event) {
+    while (!events.Push(event))
+        std::this_thread::yield();
+}
+
+// Run frames at the pace of `pacer`, and publish them
+void Frontend::emulate() {
+    pacer.Set(PaceMode::REALTIME);
+    auto lap = std::chrono::steady_clock::now();
+    while (true) {
+        InputEvent event;
+        while (events.Pop(event)) {
+            switch (event) {
+            case InputEvent::RESET:
+                nes.Reset();
+                break;
+            case InputEvent::QUIT:
+                return;
+            case InputEvent::SPEED_REALTIME:
+                pacer.Set(PaceMode::REALTIME);
+                break;
+            case InputEvent::SPEED_2X:
+                pacer.Set(PaceMode::FIXED, 2.0);
+                break;
+            case InputEvent::SPEED_4X:
+                pacer.Set(PaceMode::FIXED, 4.0);
+                break;
+            case InputEvent::SPEED_HALF:
+                pacer.Set(PaceMode::FIXED, 0.5);
+                break;
+            case InputEvent::SPEED_UNCAPPED:
+                pacer.Set(PaceMode::UNCAPPED);
+                break;
+            case InputEvent::REWIND_START:
+                rewinding = true;
+                break;
+            case InputEvent::REWIND_STOP:
+                rewinding = false;
+                break;
+            }
+        }
+
+        if (!rewinding) {
+            nes.RunFrame();
+            rewind.Push(nes);
+        } else if (rewind.Step(nes)) {
+            // back 1 snapshot per frame, the frame after it drawing the picture
+            nes.RunFrame();
+        }
+        std::memcpy(frames.Back().px, nes.ppu.frame, sizeof(Frame::px));
+        frames.Publish();
+
+        pacer.Wait();
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lap >= kFPSPeriod) {
+            fps = pacer.Lap();
+            lap = now;
+        }
+    }
+}
+
+// Speed and rewind controls
+void Frontend::key_pressed(const sf::Keyboard::Key &key) {
+    switch (key) {
+    case sf::Keyboard::Num1:
+        send(InputEvent::SPEED_REALTIME);
+        break;
+    case sf::Keyboard::Num2:
+        send(InputEvent::SPEED_2X);
+        break;
+    case sf::Keyboard::Num3:
+        send(InputEvent::SPEED_4X);
+        break;
+    case sf::Keyboard::Num4:
+        send(InputEvent::SPEED_HALF);
+        break;
+    case sf::Keyboard::Num0:
+        send(InputEvent::SPEED_UNCAPPED);
+        break;
+    case sf::Keyboard::Backspace:
+        send(InputEvent::REWIND_START);
+        break;
+    default:
+        break;
+    }
+}
+
+void Frontend::key_released(const sf::Keyboard::Key &key) {
+    if (key == sf::Keyboard::Backspace)
+        send(InputEvent::REWIND_STOP);
+}
+
+// Show the frame rate of the emulation thread in the title
+void Frontend::show_fps() {
+    char title[64];
+    std::snprintf(title, sizeof(title), "MyNES - %.1f fps (%.2fx)", fps.load(),
+                  fps.load() / 60.0988);
+    window.setTitle(title);
+}
+
+void Frontend::Run() {
+    // Texture the frames of the PPU are uploaded to
+    sf::Texture texture;
+    texture.create(kScreenW, kScreenH);
+    // Create a sprite that we can draw onto the screen
+    sf::Sprite sprite;
+    sprite.setTexture(texture);
+
+    std::thread emulation(&Frontend::emulate, this);
+    auto lap = std::chrono::steady_clock::now();
+
+    while (window.isOpen()) {
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            if (event.type == sf::Event::Closed) {
+                window.close();
+            } else if (event.type == sf::Event::GainedFocus) {
+                send(InputEvent::RESET);
+            } else if (event.type == sf::Event::KeyPressed) {
+                key_pressed(event.key.code);
+            } else if (event.type == sf::Event::KeyReleased) {
+                key_released(event.key.code);
+            }
+        }
+        if (!window.isOpen())
+            break;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lap >= kFPSPeriod) {
+            show_fps();
+            lap = now;
+        }
+
+        // Upload the newest frame, already in the RGBA layout of the texture;
+        // keep presenting the previous one until there is one
+        if (frames.Fetch())
+            texture.update((const sf::Uint8 *)frames.Front().px);
+
+        // Clear the window and draw the sprite
+        window.clear();
+        window.draw(sprite);
+
+        // Update the window, at the pace of its vsync
+        window.display();
+    }
+
+    send(InputEvent::QUIT);
+    emulation.join();
+}
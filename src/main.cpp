@@ -1,11 +1,12 @@
 #include <iostream>
 
 #include "const.hpp"
+#include "frontend.hpp"
 #include "misc.hpp"
-#include "nes.hpp"
 
 int main() {
-    NES nes;
+    Frontend frontend;
+    NES &nes = frontend.nes;
 
     nes.Load("./data/nestest.nes");
     nes.cpu.PC = 0xC000;
@@ -16,16 +17,16 @@ int main() {
     // // --- CPU test ---
     // nes.cpu.Reset();
     // for (int i = 0; i < 100; i++) {
-    //     nes.RunCycle();
+    //     nes.cpu.Step();
     //     nes.cpu.Print();
     // }
 
-    // nes.Run();
+    // frontend.Run();
 
     // ------------
 
     // smoke test
-    // nes.Run();
+    // frontend.Run();
     // nes.ppu.PrintNT();
 
     // Byte data;
@@ -45,7 +46,7 @@ int main() {
     // nametable check
     // nes.ppu.PrintNT();
     // for (int i = 0; i < 10; i++) {
-    //     nes.RunCycle();
+    //     nes.cpu.Step();
     // }
     // static constexpr uint16_t k1 = 0x2000;
     // static constexpr uint16_t k2 = 0x23C0;
@@ -61,7 +62,7 @@ int main() {
     //     nes.disk->WritePBus(i, data);
     // }
     // for (uint64_t i = 0; i < 100; i++) {
-    //     nes.RunCycle();
+    //     nes.cpu.Step();
     // }
     // for (uint16_t i = k1; i < k2; i++) {
     //     Byte data = nes.disk->ReadPBus(i);
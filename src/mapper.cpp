@@ -0,0 +1,266 @@
+#include "mapper.hpp"
+#include "disk.hpp"
+
+// ----------------------------------------------------------------------------
+// Mapper Class
+// ----------------------------------------------------------------------------
+
+// Constructor
+Mapper::Mapper() {
+    id = MapperId::NROM;
+    shift = n_shift = 0;
+    control = chr0 = chr1 = prg = 0;
+    select = 0;
+    std::fill(std::begin(bank), std::end(bank), 0);
+    irq_latch = irq_counter = 0;
+    irq_reload = irq_enable = irq = false;
+}
+
+// Destructor
+Mapper::~Mapper() {}
+
+bool Mapper::Supported(const uint8_t &n) {
+    switch ((MapperId)n) {
+    case MapperId::NROM:
+    case MapperId::MMC1:
+    case MapperId::UXROM:
+    case MapperId::CNROM:
+    case MapperId::MMC3:
+    case MapperId::AXROM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Mapper::Reset(Disk &disk) {
+    shift = n_shift = 0;
+    control = 0x0C; // MMC1: fix the last bank at 0xC000
+    chr0 = chr1 = prg = 0;
+    select = 0;
+    std::fill(std::begin(bank), std::end(bank), 0);
+    irq_latch = irq_counter = 0;
+    irq_reload = irq_enable = irq = false;
+
+    // number of 8KB PRG-ROM banks
+    const uint32_t n_prg = disk.prg_kb / 8;
+
+    switch (id) {
+    case MapperId::MMC1:
+        map_mmc1(disk);
+        return;
+    case MapperId::MMC3:
+        map_mmc3(disk);
+        return;
+    case MapperId::UXROM:
+        // last 16KB bank fixed at 0xC000
+        disk.MapPRG(0, 0);
+        disk.MapPRG(1, 1);
+        disk.MapPRG(2, n_prg - 2);
+        disk.MapPRG(3, n_prg - 1);
+        break;
+    case MapperId::AXROM:
+        disk.MapNT(MirrorMode::SINGLE);
+        for (uint8_t i = 0; i < 4; i++)
+            disk.MapPRG(i, i);
+        break;
+    default:
+        // 16KB PRG-ROM is mirrored in 0xC000 - 0xFFFF
+        for (uint8_t i = 0; i < 4; i++)
+            disk.MapPRG(i, i);
+        break;
+    }
+    for (uint8_t i = 0; i < 8; i++)
+        disk.MapCHR(i, i);
+}
+
+void Mapper::Write(Disk &disk, const uint16_t &addr, const Byte &data) {
+    switch (id) {
+    case MapperId::MMC1:
+        write_mmc1(disk, addr, data);
+        break;
+    case MapperId::MMC3:
+        write_mmc3(disk, addr, data);
+        break;
+    case MapperId::UXROM:
+        // 16KB bank at 0x8000
+        disk.MapPRG(0, data * 2);
+        disk.MapPRG(1, data * 2 + 1);
+        break;
+    case MapperId::CNROM:
+        // 8KB CHR bank
+        for (uint8_t i = 0; i < 8; i++)
+            disk.MapCHR(i, data * 8 + i);
+        break;
+    case MapperId::AXROM:
+        // 32KB bank, one-screen mirroring
+        for (uint8_t i = 0; i < 4; i++)
+            disk.MapPRG(i, (data & 0x07) * 4 + i);
+        disk.MapNT((data & 0x10) ? MirrorMode::SINGLE_HI : MirrorMode::SINGLE);
+        break;
+    default:
+        // no registers
+        break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// MMC1
+// ----------------------------------------------------------------------------
+
+void Mapper::write_mmc1(Disk &disk, const uint16_t &addr, const Byte &data) {
+    // bit 7 resets the shift register and fixes the last bank at 0xC000
+    if (data & 0x80) {
+        shift = n_shift = 0;
+        control |= 0x0C;
+        map_mmc1(disk);
+        return;
+    }
+
+    shift |= (data & 0x01) << n_shift;
+    if (++n_shift < 5)
+        return;
+
+    switch ((addr >> 13) & 0x03) {
+    case 0: // 0x8000 - 0x9FFF
+        control = shift;
+        break;
+    case 1: // 0xA000 - 0xBFFF
+        chr0 = shift;
+        break;
+    case 2: // 0xC000 - 0xDFFF
+        chr1 = shift;
+        break;
+    case 3: // 0xE000 - 0xFFFF
+        prg = shift;
+        break;
+    }
+    shift = n_shift = 0;
+    map_mmc1(disk);
+}
+
+void Mapper::map_mmc1(Disk &disk) {
+    static constexpr MirrorMode kMirror[4] = {
+        MirrorMode::SINGLE,
+        MirrorMode::SINGLE_HI,
+        MirrorMode::VERT,
+        MirrorMode::HORIZ,
+    };
+    disk.MapNT(kMirror[control & 0x03]);
+
+    // PRG-ROM, in 8KB banks
+    const uint32_t n_prg = disk.prg_kb / 8;
+    const uint32_t p = (prg & 0x0F) * 2;
+    switch ((control >> 2) & 0x03) {
+    case 0:
+    case 1:
+        for (uint8_t i = 0; i < 4; i++)
+            disk.MapPRG(i, (p & ~0x03) + i);
+        break;
+    case 2:
+        disk.MapPRG(0, 0);
+        disk.MapPRG(1, 1);
+        disk.MapPRG(2, p);
+        disk.MapPRG(3, p + 1);
+        break;
+    case 3:
+        disk.MapPRG(0, p);
+        disk.MapPRG(1, p + 1);
+        disk.MapPRG(2, n_prg - 2);
+        disk.MapPRG(3, n_prg - 1);
+        break;
+    }
+
+    // CHR, in 1KB banks
+    if (control & 0x10) {
+        for (uint8_t i = 0; i < 4; i++) {
+            disk.MapCHR(i, chr0 * 4 + i);
+            disk.MapCHR(i + 4, chr1 * 4 + i);
+        }
+    } else {
+        for (uint8_t i = 0; i < 8; i++)
+            disk.MapCHR(i, (chr0 & 0x1E) * 4 + i);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// MMC3
+// ----------------------------------------------------------------------------
+
+void Mapper::write_mmc3(Disk &disk, const uint16_t &addr, const Byte &data) {
+    switch (addr & 0xE001) {
+    case 0x8000: // bank select
+        select = data;
+        map_mmc3(disk);
+        break;
+    case 0x8001: // bank data
+        bank[select & 0x07] = data;
+        map_mmc3(disk);
+        break;
+    case 0xA000: // mirroring
+        if (disk.mirror != MirrorMode::FOUR)
+            disk.MapNT((data & 0x01) ? MirrorMode::HORIZ : MirrorMode::VERT);
+        break;
+    case 0xA001: // PRG-RAM protect: not implemented
+        break;
+    case 0xC000: // IRQ latch
+        irq_latch = data;
+        break;
+    case 0xC001: // IRQ reload
+        irq_counter = 0;
+        irq_reload = true;
+        break;
+    case 0xE000: // IRQ disable, acknowledging any pending one
+        irq_enable = false;
+        irq = false;
+        break;
+    case 0xE001: // IRQ enable
+        irq_enable = true;
+        break;
+    }
+}
+
+void Mapper::Scanline() {
+    if (irq_counter == 0 || irq_reload) {
+        irq_counter = irq_latch;
+        irq_reload = false;
+    } else {
+        irq_counter--;
+    }
+    if (irq_counter == 0 && irq_enable)
+        irq = true;
+}
+
+uint32_t Mapper::ScanlinesToIRQ() const {
+    if (id != MapperId::MMC3 || !irq_enable || irq)
+        return 0;
+    // reloaded on the next clock first
+    if (irq_counter == 0 || irq_reload)
+        return irq_latch + 1;
+    return irq_counter;
+}
+
+void Mapper::map_mmc3(Disk &disk) {
+    // PRG-ROM, in 8KB banks
+    const uint32_t n_prg = disk.prg_kb / 8;
+    if (select & 0x40) {
+        disk.MapPRG(0, n_prg - 2);
+        disk.MapPRG(2, bank[6]);
+    } else {
+        disk.MapPRG(0, bank[6]);
+        disk.MapPRG(2, n_prg - 2);
+    }
+    disk.MapPRG(1, bank[7]);
+    disk.MapPRG(3, n_prg - 1);
+
+    // CHR, in 1KB banks; A12 inversion swaps the halves
+    const uint8_t inv = (select & 0x80) ? 4 : 0;
+    disk.MapCHR(0 ^ inv, bank[0] & 0xFE);
+    disk.MapCHR(1 ^ inv, bank[0] | 0x01);
+    disk.MapCHR(2 ^ inv, bank[1] & 0xFE);
+    disk.MapCHR(3 ^ inv, bank[1] | 0x01);
+    disk.MapCHR(4 ^ inv, bank[2]);
+    disk.MapCHR(5 ^ inv, bank[3]);
+    disk.MapCHR(6 ^ inv, bank[4]);
+    disk.MapCHR(7 ^ inv, bank[5]);
+}
@@ -1,26 +1,19 @@
 #include "nes.hpp"
 
-static constexpr uint16_t kW = 256;
-static constexpr uint16_t kH = 240;
+#include <algorithm>
 
 // Constructor & Destructor
-NES::NES() {
-    cpu = CPU();
-    ppu = PPU();
-    disk = std::make_shared<Disk>();
-    cycles = 0;
-    window.create(sf::VideoMode(kW, kH), "MyNES",
-                  sf::Style::Titlebar | sf::Style::Close);
-    window.setVerticalSyncEnabled(true);
-}
+NES::NES() : disk(std::make_shared<Disk>()), clock_base(0), deadline(0) {}
 NES::~NES() {}
 
 void NES::Load(const std::string &file) {
     disk->Attach(file);
+    disk->sync = [this]() { Sync(); };
     cpu.Mount(*disk);
     ppu.Mount(*disk);
     cpu.Reset();
     ppu.Reset();
+    clock_base = ppu.clock;
     // // debug: add initial snow-screen
     // for (uint16_t i = 0x2000; i < 0x3000; i++) {
     //     Byte data = (rand() % 2) ? 0x3F : 0x30;
@@ -28,69 +21,77 @@ void NES::Load(const std::string &file) {
     // }
 }
 
-void NES::RunCycle() {
-    ppu.RunCycle();
-    if (cycles % 3 == 0) {
-        cpu.RunCycle();
-    }
-    if (ppu.nmi) {
-        ppu.nmi = false;
-        cpu.NMI();
-    }
-    cycles++;
+// Reset the CPU, keeping its position on the master clock
+void NES::Reset() {
+    const uint64_t now = Clock();
+    cpu.Reset();
+    clock_base = now - (cpu.cyc_count + cpu.cycles) * 3;
 }
 
-void NES::RunFrame() {
-    do {
-        RunCycle();
-    } while (!ppu.frame_complete);
-    do {
-        RunCycle();
-    } while (!(cpu.cycles == 0));
-    ppu.frame_complete = false;
+// Let the PPU catch up with the CPU.
+//
+// The CPU may have brought the next event closer, e.g. by enabling rendering
+// or (re)loading the mapper IRQ counter, so it is recomputed. The deadline
+// never moves later: an event the PPU just ran past is still to be delivered.
+void NES::Sync() {
+    ppu.Run(Clock());
+    deadline = std::min(deadline, ppu.clock + ppu.DotsToEvent());
 }
 
-void NES::Run() {
-    // Load the image into a texture
-    sf::Texture texture;
-    // Create a sprite that we can draw onto the screen
-    sf::Sprite sprite;
+// Skip the iterations of an idle loop the CPU is in, up to `deadline`.
+void NES::skip_idle() {
+    const uint64_t iter = cpu.IdleCycles() * 3;
+    const uint64_t now = Clock();
+    if (iter == 0 || now >= deadline)
+        return;
+    // whole iterations, until reaching the deadline
+    cpu.cyc_count += (deadline - now + iter - 1) / iter * (iter / 3);
+}
 
-    // for (size_t i = 0; i < 10000; i++)
-    //     RunCycle();
+// Halt the CPU for the OAM DMA its last instruction started: 1 cycle to halt,
+// 1 more to align on a read cycle when it was odd, then 256 read / write pairs.
+void NES::stall_dma() {
+    disk->oam_dma = false;
+    const size_t now = cpu.cyc_count + cpu.cycles;
+    cpu.cyc_count += 513 + (now & 1);
+}
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) {
-                window.close();
-                return;
-            } else if (event.type == sf::Event::GainedFocus) {
-                cpu.Reset();
-                // ppu.Reset();
+// Run until the PPU completes a frame.
+//
+// The CPU runs ahead by whole instructions until the next PPU event is due,
+// then the PPU catches up and the event (NMI, mapper IRQ) is delivered. PPU
+// register and mapper accesses in between synchronize through `Disk::sync`.
+//
+// The IRQ line is level-triggered: it is taken after any instruction as long
+// as it is asserted and the CPU does not mask it.
+//
+// Idle loops, e.g. polling PPUSTATUS or a RAM flag set by the NMI handler,
+// are fast-forwarded to the next event, as nothing can change their outcome
+// before that.
+void NES::RunFrame() {
+    while (!ppu.frame_complete) {
+        deadline = ppu.clock + ppu.DotsToEvent();
+        while (Clock() < deadline) {
+            if (cpu.blocks)
+                cpu.RunBlock((deadline - Clock() + 2) / 3);
+            else
+                cpu.Step();
+            if (disk->oam_dma)
+                stall_dma();
+            if (disk->mapper.irq) {
+                cpu.IRQ();
+            } else if (cpu.mode == AddrMode::REL && cpu.PC < cpu.addr) {
+                // a branch just jumped back
+                skip_idle();
             }
         }
-
-        // Clock enough times to draw a single frame
-        do {
-            RunCycle();
-        } while (!ppu.frame_complete);
-        // Use residual clock cycles to complete current instruction
-        do {
-            RunCycle();
-        } while (!(cpu.cycles == 0));
-        // Reset frame completion flag
-        ppu.frame_complete = false;
-
-        // Convert the updated PPU image to texture and apply to sprite
-        texture.loadFromImage(ppu.image);
-        sprite.setTexture(texture);
-
-        // Clear the window and draw the sprite
-        window.clear();
-        window.draw(sprite);
-
-        // Update the window
-        window.display();
+        Sync();
+        if (ppu.nmi) {
+            ppu.nmi = false;
+            cpu.NMI();
+        } else if (disk->mapper.irq) {
+            cpu.IRQ();
+        }
     }
+    ppu.frame_complete = false;
 }
@@ -0,0 +1,61 @@
+#include "pacer.hpp"
+
+#include <thread>
+
+// NTSC frame rate: 60.0988 Hz, 89341.5 dots per frame on average (odd
+// frames are 1 dot shorter) of a 5.369318 MHz PPU clock
+static constexpr std::chrono::nanoseconds kFramePeriod(16639263);
+
+// the sleeps end this early, to spin the rest of the way
+static constexpr std::chrono::microseconds kSpin(1500);
+
+// frames the pacing may fall behind before giving up catching up on them
+static constexpr uint32_t kMaxLag = 4;
+
+// ----------------------------------------------------------------------------
+// Pacer Class
+// ----------------------------------------------------------------------------
+
+// Constructor
+Pacer::Pacer() { Set(PaceMode::REALTIME); }
+
+// Destructor
+Pacer::~Pacer() {}
+
+void Pacer::Set(const PaceMode &m, const double &s) {
+    mode = m;
+    speed = m == PaceMode::FIXED ? s : 1.0;
+    period = std::chrono::duration_cast<Clock::duration>(kFramePeriod / speed);
+    next = lap = Clock::now();
+    frames = 0;
+}
+
+void Pacer::Wait() {
+    frames++;
+    if (mode == PaceMode::UNCAPPED)
+        return;
+
+    next += period;
+    Clock::time_point now = Clock::now();
+    if (now >= next) {
+        // running late: after a long stall (e.g. the host suspended us), start
+        // over rather than running the missed frames as fast as possible
+        if (now - next > period * kMaxLag)
+            next = now;
+        return;
+    }
+
+    if (next - now > kSpin)
+        std::this_thread::sleep_until(next - kSpin);
+    while (Clock::now() < next)
+        std::this_thread::yield();
+}
+
+double Pacer::Lap() {
+    const Clock::time_point now = Clock::now();
+    const double dt = std::chrono::duration<double>(now - lap).count();
+    const double fps = dt > 0 ? frames / dt : 0;
+    lap = now;
+    frames = 0;
+    return fps;
+}
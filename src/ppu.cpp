@@ -1,76 +1,171 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
 #include <iostream>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "misc.hpp"
 #include "ppu.hpp"
 
-static constexpr uint16_t kW = 256;
-static constexpr uint16_t kH = 240;
+// dots per scanline / frame
+static constexpr uint32_t kDots = 341;
+static constexpr uint32_t kFrameDots = kDots * 262;
+// position (scanline * kDots + cycle) of the dot setting the vblank flag
+static constexpr uint32_t kVBlankPos = 241 * kDots + 1;
 
-// Function to set a pixel to a specific color in an sf::Image
-static void set_pixel(sf::Image &image, const uint16_t x, const uint16_t y,
-                      uint8_t ind) {
-    if (x < image.getSize().x && y < image.getSize().y) {
-        image.setPixel(x, y, sf::Color(PAL_MASTER[ind]));
-    }
+// Color (0xRRGGBBAA) as a pixel of `PPU::frame`, i.e. laid out as the bytes
+// R, G, B, A whatever the endianness
+static inline uint32_t to_pixel(const uint32_t &color) {
+    const Byte rgba[4] = {(Byte)(color >> 24), (Byte)(color >> 16),
+                          (Byte)(color >> 8), (Byte)color};
+    uint32_t pixel;
+    std::memcpy(&pixel, rgba, 4);
+    return pixel;
 }
 
-// ScanLine State, as per the PPU's scanline ranges
+// Flags of `PPU::fg_line`, next to the palette address (0x10 - 0x1F)
+static constexpr Byte kFgBehind = 0x20; // behind the background
+static constexpr Byte kFgZero = 0x40;   // pixel of sprite 0
+
+// ScanLine State, as per the PPU's scanline ranges; each has its own row of
+// dot actions
 enum class SLState : uint8_t {
-    // Any state outside the defined rendering process
+    // Lines without any action: post-render (240), post-VB (242-260)
     IDLE = 0,
     // Pre-render: traditionally line == -1, adjusted to 261 for zero-indexing
     PRE,
-    // first line of visible rendering (0)
-    INIT,
-    // Visible scanlines (1-239)
+    // Pre-render line of odd frames, 1 dot shorter while rendering
+    PRE_ODD,
+    // Visible scanlines (0-239)
     RENDER,
-    // Scanline 240, where no rendering occurs
-    POST,
-    // Vertical blanking lines (241)
+    // Vertical blanking line (241)
     VB,
-    // post-VB lines (242-260), where no rendering occurs
-    VBPOST,
 };
+static constexpr uint8_t kSLStates = 5;
 
-// Function to determine the current PPU render state.
-static inline SLState GetSLState(const uint16_t &sl) {
-    if (sl == 261) {
-        // further refine as per the PPU's cycle timings
-        return SLState::PRE;
-    } else if (sl == 0) {
-        // further refine as per the PPU's cycle timings
-        return SLState::INIT;
-    } else if (sl >= 1 && sl < 240) {
-        // further refine as per the PPU's cycle timings
-        return SLState::RENDER;
-    } else if (sl == 240) {
-        // Post-render line, no actual rendering
-        return SLState::POST;
-    } else if (sl == 241) {
-        // Vertical blanking line
-        return SLState::VB;
-    } else if (sl >= 242 && sl <= 260) {
-        // Post-VB lines, no rendering
-        return SLState::VBPOST;
-    } else {
-        // Any other state is considered Idle
-        return SLState::IDLE;
+// State of each scanline (0 - 261), on even and odd frames
+static constexpr auto kLineStates = []() {
+    std::array<std::array<SLState, 262>, 2> table{};
+    for (uint8_t odd = 0; odd < 2; odd++) {
+        for (uint16_t sl = 0; sl < 262; sl++) {
+            if (sl < 240)
+                table[odd][sl] = SLState::RENDER;
+            else if (sl == 241)
+                table[odd][sl] = SLState::VB;
+            else if (sl == 261)
+                table[odd][sl] = odd ? SLState::PRE_ODD : SLState::PRE;
+            else
+                table[odd][sl] = SLState::IDLE;
+        }
     }
-}
+    return table;
+}();
+
+// Actions of a dot, run in this order by `PPU::RunCycle`
+static constexpr uint16_t kBgShift = 1 << 0;   // shift the BG shifters
+static constexpr uint16_t kBgLoad = 1 << 1;    // load the next tile into them
+static constexpr uint16_t kFetchNT = 1 << 2;   // fetch the next tile id
+static constexpr uint16_t kFetchAT = 1 << 3;   // ... its attribute
+static constexpr uint16_t kFetchLo = 1 << 4;   // ... its low bit plane
+static constexpr uint16_t kFetchHi = 1 << 5;   // ... its high bit plane
+static constexpr uint16_t kIncX = 1 << 6;      // next tile column
+static constexpr uint16_t kIncY = 1 << 7;      // next row of pixels
+static constexpr uint16_t kCopyX = 1 << 8;     // horizontal scroll from T
+static constexpr uint16_t kCopyY = 1 << 9;     // vertical scroll from T
+static constexpr uint16_t kEvalFg = 1 << 10;   // sprites of the next line
+static constexpr uint16_t kMapper = 1 << 11;   // scanline clock of the mapper
+static constexpr uint16_t kClear = 1 << 12;    // clear VBlank, sprite flags
+static constexpr uint16_t kVBlank = 1 << 13;   // set VBlank, NMI
+static constexpr uint16_t kPixel = 1 << 14;    // output a pixel
+static constexpr uint16_t kSkip = 1 << 15;     // skip the next dot if rendering
+// the fetches of the tiles, and the actions of a few dots per line only
+static constexpr uint16_t kFetch =
+    kBgLoad | kFetchNT | kFetchAT | kFetchLo | kFetchHi | kIncX;
+static constexpr uint16_t kRare = kIncY | kCopyX | kCopyY | kEvalFg | kMapper |
+                                  kClear | kVBlank | kSkip;
+
+// Actions of each dot of each kind of line.
+//
+// The rendering lines fetch a tile every 8 dots over 1 - 256 and 321 - 336
+// (the first 2 tiles of the next line), shifting the BG shifters on the way;
+// see https://www.nesdev.org/wiki/PPU_rendering for the timing diagram.
+static constexpr auto kDotActions = []() {
+    std::array<std::array<uint16_t, kDots>, kSLStates> table{};
+    for (const SLState state : {SLState::PRE, SLState::PRE_ODD,
+                                SLState::RENDER}) {
+        std::array<uint16_t, kDots> &dots = table[(uint8_t)state];
+        for (uint16_t dot = 0; dot < kDots; dot++) {
+            uint16_t act = 0;
+            if ((dot >= 1 && dot < 258) || (dot >= 321 && dot < 338)) {
+                act |= kBgShift;
+                switch ((dot - 1) % 8) {
+                case 0:
+                    act |= kBgLoad | kFetchNT;
+                    break;
+                case 2:
+                    act |= kFetchAT;
+                    break;
+                case 4:
+                    act |= kFetchLo;
+                    break;
+                case 6:
+                    act |= kFetchHi;
+                    break;
+                case 7:
+                    act |= kIncX;
+                    break;
+                }
+            }
+            if (dot == 256)
+                act |= kIncY;
+            if (dot == 257)
+                act |= kCopyX | kEvalFg;
+            if (dot == 260)
+                act |= kMapper;
+            if (dot == 338 || dot == 340)
+                act |= kFetchNT;
+
+            if (state == SLState::RENDER) {
+                if (dot >= 1 && dot <= kScreenW)
+                    act |= kPixel;
+            } else {
+                if (dot == 1)
+                    act |= kClear;
+                if (dot >= 280 && dot < 305)
+                    act |= kCopyY;
+            }
+            if (state == SLState::PRE_ODD && dot == 339)
+                act |= kSkip;
+            dots[dot] = act;
+        }
+    }
+    table[(uint8_t)SLState::VB][1] = kVBlank;
+    return table;
+}();
 
 // Constructor
 PPU::PPU() {
     // Initialize registers
     scanline = cycle = 0;
+    clock = 0;
     bg_shift_pat_lo = bg_shift_pat_hi = 0;
     bg_shift_attr_hi = bg_shift_attr_lo = 0;
     bg_tile_id = bg_tile_attr = bg_tile_lo = bg_tile_hi = 0;
     nmi = false;
     frame_complete = false;
+    odd_frame = false;
+    lines = true;
 
     // Initialize memory to nullptr
     disk = nullptr;
-    image.create(kW, kH, sf::Color::Black);
+    std::fill(std::begin(frame), std::end(frame), to_pixel(PAL_MASTER[0x0F]));
+    std::fill(std::begin(colors), std::end(colors), to_pixel(PAL_MASTER[0x0F]));
+    std::fill(std::begin(fg_line), std::end(fg_line), 0);
+    fg_count = 0;
 }
 
 void PPU::Reset() {
@@ -80,8 +175,10 @@ void PPU::Reset() {
     bg_shift_attr_hi = bg_shift_attr_lo = 0;
     bg_tile_id = bg_tile_attr = bg_tile_lo = bg_tile_hi = 0;
     nmi = false;
+    std::fill(std::begin(fg_line), std::end(fg_line), 0);
+    fg_count = 0;
 
-    image.create(kW, kH, sf::Color::Black);
+    std::fill(std::begin(frame), std::end(frame), to_pixel(PAL_MASTER[0x0F]));
 }
 
 // Destructor
@@ -121,68 +218,391 @@ void PPU::PrintXY() {
 }
 
 // TODO: shared_ptr
-void PPU::Mount(const Disk &disk) { this->disk = (Disk *)&disk; }
+void PPU::Mount(const Disk &disk) {
+    this->disk = (Disk *)&disk;
+    this->disk->pal_dirty = true;
+}
+
+// Resolve the palette into `colors`.
+//
+// Greyscale keeps the column 0x00, 0x10, 0x20, 0x30 of the master palette;
+// each emphasis bit dims the other 2 channels to about 82%.
+void PPU::update_colors() {
+    const bool gray = disk->pram.mask.gray;
+    const bool red = disk->pram.mask.red;
+    const bool grn = disk->pram.mask.grn;
+    const bool blu = disk->pram.mask.blu;
+    const bool emphasis = red || grn || blu;
 
+    for (uint8_t i = 0; i < 32; i++) {
+        // 0x10, 0x14, 0x18, 0x1C are stored at 0x00, 0x04, 0x08, 0x0C, and
+        // the pixels 0 of every palette show 0x00 anyway
+        Byte index = disk->pal[(i & 0x03) ? i : 0] & 0x3F;
+        if (gray)
+            index &= 0x30;
+
+        uint32_t color = PAL_MASTER[index];
+        if (emphasis) {
+            uint32_t r = (color >> 24) & 0xFF;
+            uint32_t g = (color >> 16) & 0xFF;
+            uint32_t b = (color >> 8) & 0xFF;
+            if (!red)
+                r = r * 209 / 256;
+            if (!grn)
+                g = g * 209 / 256;
+            if (!blu)
+                b = b * 209 / 256;
+            color = (r << 24) | (g << 16) | (b << 8) | (color & 0xFF);
+        }
+        colors[i] = to_pixel(color);
+    }
+    disk->pal_dirty = false;
+}
+
+// Run one dot, as per `kDotActions`: the row of the line is looked up in
+// `kLineStates`, without branching on the scanline
 void PPU::RunCycle() {
-    SLState state = GetSLState(scanline);
-    switch (state) {
-    case SLState::PRE:
-        pre_render();
-    case SLState::INIT:
-        render_init();
-    case SLState::RENDER:
-        render();
-    case SLState::VB:
-        vblank();
-    default:
-        break;
-    }
-
-    // The 2-bit pixel to be rendered
-    uint8_t bg_pixel = 0x00;
-    // The 3-bit index of the palette the pixel indexes
-    uint8_t bg_palette = 0x00;
-
-    // only render the background if the PPU is enabled
-    if (disk->pram.mask.bg || !disk->pram.mask.bg) {
-        // TODO: add documentation
-        uint16_t bit_mux = 0x8000 >> disk->pram.x;
-
-        // Select plane pixels by extracting from the shifter
-        // at the required location.
-        uint8_t p0_pixel = (bg_shift_pat_lo & bit_mux) > 0;
-        uint8_t p1_pixel = (bg_shift_pat_hi & bit_mux) > 0;
-
-        // Combine to form pixel index
-        bg_pixel = (p1_pixel << 1) | p0_pixel;
-
-        // Get palette
-        uint8_t bg_pal0 = (bg_shift_attr_lo & bit_mux) > 0;
-        uint8_t bg_pal1 = (bg_shift_attr_hi & bit_mux) > 0;
-        bg_palette = (bg_pal1 << 1) | bg_pal0;
-    }
-
-    uint8_t color =
-        disk->ReadPBus(0x3F00 + (bg_palette << 2) + bg_pixel) & 0x3F;
-    set_pixel(image, cycle - 1, scanline, color);
-
-    // Debugging
-    // set_pixel(image, cycle - 1, scanline, (rand() % 2) ? 0x3F : 0x30);
-    // std::cout << Misc::hex(color, 2) << "; Palette:" << Misc::hex(bg_palette,
-    // 2)
-    //           << "; Pixel:" << Misc::hex(bg_pixel, 2) << std::endl;
-    // PrintNT();
-    // std::cout << Misc::hex(disk->pram.v.y, 2) << std::endl;
-    // PrintTile();
-    // std::cout << Misc::hex((disk->pram.v.reg & 0x0FFF), 4) << std::endl;
+    const SLState state = kLineStates[odd_frame][scanline];
+    const uint16_t act = kDotActions[(uint8_t)state][cycle];
 
+    if (act & kBgShift)
+        update_bg_shift();
+    if (act & kFetch) {
+        if (act & kBgLoad)
+            load_bg_shift();
+        if (act & kFetchNT)
+            fetch_bg_nt();
+        if (act & kFetchAT)
+            fetch_bg_at();
+        if (act & kFetchLo)
+            fetch_bg_tile_lo();
+        if (act & kFetchHi)
+            fetch_bg_tile_hi();
+        if (act & kIncX)
+            inc_bg_x();
+    }
+    if (act & kRare) {
+        if (act & kIncY)
+            inc_bg_y();
+        if (act & kCopyX)
+            transfer_x();
+        if (act & kCopyY)
+            transfer_y();
+        if (act & kEvalFg)
+            eval_sprites();
+        if (act & kMapper)
+            clock_scanline();
+        if (act & kClear) {
+            disk->pram.status.vbk = 0;
+            disk->pram.status.fgof = 0;
+            disk->pram.status.fgzh = 0;
+        }
+        if (act & kVBlank) {
+            disk->pram.status.vbk = 1;
+            if (disk->pram.ctrl.nmi)
+                nmi = true;
+        }
+    }
+    if (act & kPixel) {
+        const uint16_t x = cycle - 1;
+        sync_colors();
+        frame[scanline * kScreenW + x] =
+            mix_pixel(x, clip_bg(x, bg_pal_addr()));
+    }
+
+    clock++;
     cycle++;
+    // odd frames skip the last dot of the pre-render line while rendering
+    if ((act & kSkip) && (disk->pram.mask.bg || disk->pram.mask.fg))
+        cycle++;
     if (cycle >= 341) {
         cycle = 0;
         scanline++;
         if (scanline > 261) {
             scanline = 0;
             frame_complete = true;
+            odd_frame = !odd_frame;
+        }
+    }
+}
+
+// Palette address (attribute << 2 | pixel) at bit `bit` of the 4 background
+// shifters, or of the tile latches widened to them
+static inline Byte shifter_px(const uint16_t &pat_lo, const uint16_t &pat_hi,
+                              const uint16_t &attr_lo, const uint16_t &attr_hi,
+                              const uint8_t &bit) {
+    return ((pat_lo >> bit) & 0x01) | (((pat_hi >> bit) & 0x01) << 1) |
+           (((attr_lo >> bit) & 0x01) << 2) | (((attr_hi >> bit) & 0x01) << 3);
+}
+
+// Bit `bit` of the palette addresses of 8 dots, leftmost in bit 7, i.e. the
+// byte a shifter gets them from
+static inline uint8_t gather_bits(const Byte *px, const uint8_t &bit) {
+    uint8_t data = 0;
+    for (uint8_t i = 0; i < 8; i++)
+        data |= ((px[i] >> bit) & 0x01) << (7 - i);
+    return data;
+}
+
+// Render dots 1 - 256 of a visible line (0 - 239) at once.
+//
+// Same fetches and pixels as `RunCycle` dot by dot, minus the per-dot
+// dispatch and the shifting: the dots leave the shifters in the order their
+// tiles were loaded, so the line is laid out as a row of palette addresses,
+// out of the decoded tiles (see `Disk::ReadTileRow`), and read back at the
+// fine X offset. The shifters and latches are left as the dots would.
+void PPU::render_line() {
+    const bool shift = disk->pram.mask.bg;
+    sync_colors();
+
+    // Palette addresses in the order they leave the shifters: the 8 in their
+    // high bytes (as of the first shift), the tile in the latches, loaded at
+    // dot 1, then the 31 tiles fetched on the way, each loaded 8 dots later,
+    // and the 0s shifted in after the last one.
+    alignas(8) Byte px[8 + 8 + 31 * 8 + 8];
+    for (uint8_t i = 0; i < 8; i++) {
+        px[i] = shifter_px(bg_shift_pat_lo, bg_shift_pat_hi, bg_shift_attr_lo,
+                           bg_shift_attr_hi, 14 - i);
+        px[8 + i] = shifter_px(bg_tile_lo, bg_tile_hi,
+                               (bg_tile_attr & 0b01) ? 0xFF : 0x00,
+                               (bg_tile_attr & 0b10) ? 0xFF : 0x00, 7 - i);
+    }
+    const uint16_t table = disk->pram.ctrl.bgp << 12;
+    for (uint16_t k = 0; k < 32; k++) {
+        fetch_bg_nt();
+        fetch_bg_at();
+        if (k < 31) {
+            const Byte *row = disk->ReadTileRow(
+                table + ((uint16_t)bg_tile_id << 4) + disk->pram.v.y);
+            // the attribute into all 8 bytes of the row at once
+            uint64_t data;
+            std::memcpy(&data, row, 8);
+            data |= (uint64_t)(bg_tile_attr << 2) * 0x0101010101010101;
+            std::memcpy(px + 16 + k * 8, &data, 8);
+        } else {
+            // the last tile stays in the latches until dot 257
+            fetch_bg_tile_lo();
+            fetch_bg_tile_hi();
         }
+        inc_bg_x();
+    }
+    inc_bg_y();
+    std::fill_n(px + 16 + 31 * 8, 8, 0);
+
+    if (shift) {
+        // the shifters hold the next 16 dots
+        const Byte *next = px + 255;
+        bg_shift_pat_lo =
+            (gather_bits(next, 0) << 8) | gather_bits(next + 8, 0);
+        bg_shift_pat_hi =
+            (gather_bits(next, 1) << 8) | gather_bits(next + 8, 1);
+        bg_shift_attr_lo =
+            (gather_bits(next, 2) << 8) | gather_bits(next + 8, 2);
+        bg_shift_attr_hi =
+            (gather_bits(next, 3) << 8) | gather_bits(next + 8, 3);
+    } else {
+        // the low bytes hold the last tile loaded
+        const Byte *last = px + 256;
+        bg_shift_pat_lo = (bg_shift_pat_lo & 0xFF00) | gather_bits(last, 0);
+        bg_shift_pat_hi = (bg_shift_pat_hi & 0xFF00) | gather_bits(last, 1);
+        bg_shift_attr_lo = (bg_shift_attr_lo & 0xFF00) | gather_bits(last, 2);
+        bg_shift_attr_hi = (bg_shift_attr_hi & 0xFF00) | gather_bits(last, 3);
     }
+
+    // the background as shown, at the fine X offset
+    Byte *bg = px + disk->pram.x;
+    if (!shift)
+        std::fill_n(bg, kScreenW, 0);
+    else if (!disk->pram.mask.bgl)
+        std::fill_n(bg, 8, 0);
+    mix_line(frame + scanline * kScreenW, bg);
+
+    clock += 256;
+    cycle = 257;
+}
+
+// ----------------------------------------------------------------------------
+// Sprites
+// ----------------------------------------------------------------------------
+
+// Bit mask of the sprites in range of line `line` (0 - 239), i.e. whose top
+// row `y` is within the `h` lines up to it. Sprites at y >= 240 never show.
+static inline uint64_t sprites_in_range(const OAM &oam, const uint8_t &line,
+                                        const uint8_t &h) {
+    uint64_t found = 0;
+#if defined(__SSE2__)
+    // 16 sprites at a time: line - y < h, as unsigned bytes
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i l = _mm_set1_epi8((char)line);
+    const __m128i last_row = _mm_set1_epi8((char)(h - 1));
+    const __m128i last_y = _mm_set1_epi8((char)239);
+    for (uint8_t i = 0; i < 64; i += 16) {
+        const __m128i y = _mm_load_si128((const __m128i *)(oam.y + i));
+        const __m128i row = _mm_sub_epi8(l, y);
+        const __m128i in = _mm_and_si128(
+            _mm_cmpeq_epi8(_mm_subs_epu8(row, last_row), zero),
+            _mm_cmpeq_epi8(_mm_subs_epu8(y, last_y), zero));
+        found |= (uint64_t)(uint16_t)_mm_movemask_epi8(in) << i;
+    }
+#else
+    for (uint8_t i = 0; i < 64; i++) {
+        if (oam.y[i] < 240 && (uint8_t)(line - oam.y[i]) < h)
+            found |= (uint64_t)1 << i;
+    }
+#endif
+    return found;
+}
+
+// Evaluate the sprites of the next line (dot 257).
+//
+// The first 8 sprites in range, in OAM order, are fetched out of the decoded
+// tiles and laid out into `fg_line` back to front, so that the front-most
+// opaque pixel wins whatever its priority. A 9th sets the overflow flag
+// (without the false positives / negatives of the hardware). The pre-render
+// line finds none, as the PPU does not evaluate there.
+void PPU::eval_sprites() {
+    if (fg_count) {
+        std::fill(std::begin(fg_line), std::end(fg_line), 0);
+        fg_count = 0;
+    }
+    if (!(disk->pram.mask.bg || disk->pram.mask.fg))
+        return;
+    // OAMADDR is cleared during the sprite fetches
+    disk->pram.oamaddr = 0;
+    if (scanline >= 240)
+        return;
+
+    const OAM &oam = disk->oam;
+    const uint8_t h = disk->pram.ctrl.ssz ? 16 : 8;
+    uint64_t found = sprites_in_range(oam, scanline, h);
+
+    uint8_t list[8];
+    while (found && fg_count < 8) {
+        list[fg_count++] = std::countr_zero(found);
+        found &= found - 1;
+    }
+    if (found)
+        disk->pram.status.fgof = 1;
+
+    for (int8_t k = fg_count - 1; k >= 0; k--) {
+        const uint8_t i = list[k];
+        const Byte attr = oam.attr[i];
+        uint8_t row = scanline - oam.y[i];
+        if (attr & 0x80)
+            row = h - 1 - row;
+
+        // 8x16 sprites take their pattern table from bit 0 of the tile, the
+        // bottom half being the next tile
+        uint16_t addr;
+        if (h == 16) {
+            addr = ((oam.tile[i] & 0x01) << 12) |
+                   (((oam.tile[i] & 0xFE) + (row >> 3)) << 4) | (row & 0x07);
+        } else {
+            addr = (disk->pram.ctrl.fgp << 12) | (oam.tile[i] << 4) | row;
+        }
+        const Byte *px = disk->ReadTileRow(addr);
+
+        const Byte flags = 0x10 | ((attr & 0x03) << 2) |
+                           ((attr & 0x20) ? kFgBehind : 0) |
+                           (i == 0 ? kFgZero : 0);
+        const bool flip = attr & 0x40;
+        for (uint16_t j = 0, x = oam.x[i]; j < 8 && x < kScreenW; j++, x++) {
+            const Byte p = px[flip ? 7 - j : j];
+            if (p)
+                fg_line[x] = flags | p;
+        }
+    }
+}
+
+// Sprite 0 hits where its opaque pixel meets an opaque background pixel,
+// except at the last dot; the clipping of either side in the leftmost 8
+// dots hides the hit as well.
+inline uint32_t PPU::mix_pixel(const uint16_t &x, const Byte &bg) {
+    Byte fg = fg_line[x];
+    if (!disk->pram.mask.fg || (x < 8 && !disk->pram.mask.fgl))
+        fg = 0;
+    if (!fg)
+        return colors[bg];
+
+    const bool opaque = bg & 0x03;
+    if ((fg & kFgZero) && opaque && x != 255)
+        disk->pram.status.fgzh = 1;
+    return colors[(opaque && (fg & kFgBehind)) ? bg : fg & 0x1F];
+}
+
+void PPU::mix_line(uint32_t *line, const Byte *bg) {
+    if (!fg_count || !disk->pram.mask.fg) {
+        for (uint16_t x = 0; x < kScreenW; x++)
+            line[x] = colors[bg[x]];
+        return;
+    }
+    for (uint16_t x = 0; x < kScreenW; x++)
+        line[x] = mix_pixel(x, bg[x]);
+}
+
+// Catch up with the master clock.
+//
+// The CPU writes the PPU registers only after the PPU caught up with it, so
+// they do not change until `until`: whole visible lines before it are
+// rendered at once, and the idle lines of vblank are skipped. A line the CPU
+// writes in the middle of runs dot by dot up to the write.
+void PPU::Run(const uint64_t &until) {
+    while (clock < until) {
+        if (!lines) {
+            RunCycle();
+        } else if (cycle == 1 && scanline < kScreenH &&
+                   clock + 256 <= until) {
+            render_line();
+        } else if (scanline >= 242 && scanline < 261) {
+            // nothing happens until the pre-render line
+            const uint32_t pos = scanline * kDots + cycle;
+            const uint32_t n = MIN(until - clock, 261 * kDots - pos);
+            clock += n;
+            scanline = (pos + n) / kDots;
+            cycle = (pos + n) % kDots;
+        } else {
+            RunCycle();
+        }
+    }
+}
+
+// Number of dots to run until the `n`-th next scanline clock of the mapper, or
+// `end` if it does not happen before.
+//
+// The counter is clocked at dot 260 of the visible and pre-render lines, while
+// rendering is enabled; enabling / disabling it goes through PPUMASK, after
+// which the CPU asks again.
+static uint32_t dots_to_irq(const uint32_t &pos, uint32_t n,
+                            const uint32_t &end) {
+    for (uint32_t sl = pos / kDots; sl < 262; sl++) {
+        if (sl >= 240 && sl < 261)
+            continue;
+        const uint32_t at = sl * kDots + 260;
+        if (at < pos)
+            continue;
+        // run the clock dot itself as well
+        if (at - pos + 1 >= end)
+            break;
+        if (--n == 0)
+            return at - pos + 1;
+    }
+    return end;
+}
+
+uint32_t PPU::DotsToEvent() const {
+    const uint32_t pos = scanline * kDots + cycle;
+    // the odd frames skipping a dot, see `RunCycle`
+    uint32_t end = kFrameDots;
+    if (odd_frame && (disk->pram.mask.bg || disk->pram.mask.fg) &&
+        pos < kFrameDots - 1) {
+        end--;
+    }
+    // run the vblank dot itself as well
+    const uint32_t dots =
+        pos <= kVBlankPos ? kVBlankPos - pos + 1 : end - pos;
+
+    const uint32_t n = disk->mapper.ScanlinesToIRQ();
+    if (n == 0 || !(disk->pram.mask.bg || disk->pram.mask.fg))
+        return dots;
+    return dots_to_irq(pos, n, dots);
 }
@@ -0,0 +1,180 @@
+#include "rewind.hpp"
+
+#include <chrono>
+#include <cstring>
+
+// longest run of a token
+static constexpr size_t kRunMax = 0xFFFF;
+// unchanged bytes in a row ending a run of changed ones: shorter runs are
+// cheaper to store along with the changed bytes than in a token of their own
+static constexpr size_t kMinUnchanged = 4;
+// size of a token, before its changed bytes
+static constexpr size_t kTokenSize = 4;
+// largest delta of a whole savestate: every token but the first, and those
+// following a run of kRunMax changed bytes, covers at least as many bytes as
+// it takes
+static constexpr size_t kMaxDelta =
+    sizeof(SaveState) + kTokenSize * (sizeof(SaveState) / kRunMax + 2);
+
+// Encode `cur` XOR `prev` (`n` bytes each) into `out`; returns its size
+static size_t encode_delta(const Byte *cur, const Byte *prev, const size_t &n,
+                           Byte *out) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < n) {
+        // unchanged bytes, 8 at a time where possible
+        size_t same = 0;
+        while (i + same < n && same < kRunMax) {
+            uint64_t a, b;
+            if (i + same + 8 <= n && same + 8 <= kRunMax) {
+                std::memcpy(&a, cur + i + same, 8);
+                std::memcpy(&b, prev + i + same, 8);
+                if (a == b) {
+                    same += 8;
+                    continue;
+                }
+            }
+            if (cur[i + same] != prev[i + same])
+                break;
+            same++;
+        }
+        i += same;
+
+        // changed bytes, until `kMinUnchanged` unchanged ones in a row
+        size_t diff = 0;
+        size_t unchanged = 0;
+        while (i + diff < n && diff < kRunMax) {
+            if (cur[i + diff] != prev[i + diff]) {
+                unchanged = 0;
+            } else if (++unchanged == kMinUnchanged) {
+                diff -= kMinUnchanged - 1;
+                break;
+            }
+            diff++;
+        }
+
+        const uint16_t token[2] = {(uint16_t)same, (uint16_t)diff};
+        std::memcpy(out + o, token, kTokenSize);
+        o += kTokenSize;
+        for (size_t k = 0; k < diff; k++)
+            out[o + k] = cur[i + k] ^ prev[i + k];
+        o += diff;
+        i += diff;
+    }
+    return o;
+}
+
+// XOR a delta of `size` bytes into `state`
+static void apply_delta(const Byte *in, const size_t &size, Byte *state) {
+    size_t i = 0;
+    size_t o = 0;
+    while (o < size) {
+        uint16_t token[2];
+        std::memcpy(token, in + o, kTokenSize);
+        o += kTokenSize;
+        i += token[0];
+        for (size_t k = 0; k < token[1]; k++)
+            state[i + k] ^= in[o + k];
+        o += token[1];
+        i += token[1];
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Rewind Class
+// ----------------------------------------------------------------------------
+
+// Constructor
+Rewind::Rewind(const size_t &capacity, const uint32_t &interval)
+    : interval(interval), ring(capacity), scratch(kMaxDelta) {
+    // zeroed, so that the padding of the states compares equal
+    last = std::make_unique<SaveState>();
+    cur = std::make_unique<SaveState>();
+    pushed = 0;
+    push_time = push_time_max = 0;
+    Clear();
+}
+
+// Destructor
+Rewind::~Rewind() {}
+
+void Rewind::Clear() {
+    entries.clear();
+    head = 0;
+    used = 0;
+    has_last = false;
+    frames = 0;
+}
+
+size_t Rewind::Count() const { return has_last ? entries.size() + 1 : 0; }
+
+size_t Rewind::Used() const { return used; }
+
+void Rewind::Push(const NES &nes) {
+    if (++frames < interval)
+        return;
+    frames = 0;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    if (!has_last) {
+        nes.Save(*last);
+        has_last = true;
+    } else {
+        nes.Save(*cur);
+        const size_t size = encode_delta((const Byte *)cur.get(),
+                                         (const Byte *)last.get(),
+                                         sizeof(SaveState), scratch.data());
+        if (size > ring.size()) {
+            // does not fit at all: the history starts over from here
+            entries.clear();
+            head = used = 0;
+        } else {
+            if (head + size > ring.size()) {
+                // the end of the ring is left unused: the deltas still there,
+                // the oldest ones, would be overwritten as soon as the ring
+                // gets there again, drop them already
+                while (!entries.empty() && entries.front().offset >= head) {
+                    used -= entries.front().size;
+                    entries.pop_front();
+                }
+                head = 0;
+            }
+            // drop the oldest deltas in the way
+            while (!entries.empty() && entries.front().offset < head + size &&
+                   entries.front().offset + entries.front().size > head) {
+                used -= entries.front().size;
+                entries.pop_front();
+            }
+            std::memcpy(ring.data() + head, scratch.data(), size);
+            entries.push_back({head, size});
+            head += size;
+            used += size;
+        }
+        std::swap(last, cur);
+    }
+    const double dt = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+
+    pushed++;
+    push_time += dt;
+    push_time_max = MAX(push_time_max, dt);
+}
+
+bool Rewind::Step(NES &nes) {
+    if (!has_last)
+        return false;
+    nes.Load(*last);
+    frames = 0;
+
+    if (entries.empty()) {
+        has_last = false;
+        return true;
+    }
+    const Entry &entry = entries.back();
+    apply_delta(ring.data() + entry.offset, entry.size, (Byte *)last.get());
+    head = entry.offset;
+    used -= entry.size;
+    entries.pop_back();
+    return true;
+}
@@ -0,0 +1,173 @@
+#include "rom.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "chr.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ROM_MMAP 1
+#else
+#define ROM_MMAP 0
+#endif
+
+// Constant $4E $45 $53 $1A (ASCII "NES" followed by MS-DOS end-of-file)
+static constexpr char NES_NAME[4] = {0x4E, 0x45, 0x53, 0x1A};
+
+// ----------------------------------------------------------------------------
+// Cache
+// ----------------------------------------------------------------------------
+
+// ROMs currently loaded, by hash of their contents. The cache does not keep
+// them alive: a ROM is unmapped once the last disk using it goes away.
+static std::mutex cache_mutex;
+static std::unordered_map<uint64_t, std::weak_ptr<const Rom>> cache;
+
+// FNV-1a over 8-byte words, then the remaining bytes
+static uint64_t hash_image(const Byte *data, const size_t &size) {
+    constexpr uint64_t kPrime = 0x00000100000001B3;
+    uint64_t hash = 0xCBF29CE484222325 ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * kPrime;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * kPrime;
+    return hash;
+}
+
+// ----------------------------------------------------------------------------
+// Loading
+// ----------------------------------------------------------------------------
+
+#if ROM_MMAP
+static void map_image(const std::string &path, Rom &rom) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open file: " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(NesHdr)) {
+        close(fd);
+        throw std::runtime_error("Failed to read header");
+    }
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        throw std::runtime_error("Failed to map file: " + path);
+
+    rom.data = (const Byte *)addr;
+    rom.size = st.st_size;
+    rom.mapped = true;
+}
+#else
+static void map_image(const std::string &path, Rom &rom) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open file: " + path);
+
+    rom.buffer.resize(file.tellg());
+    file.seekg(0);
+    if (!file.read((char *)rom.buffer.data(), rom.buffer.size()))
+        throw std::runtime_error("Failed to read file: " + path);
+
+    rom.data = rom.buffer.data();
+    rom.size = rom.buffer.size();
+    rom.mapped = false;
+}
+#endif
+
+// Locate the header, PRG-ROM and CHR-ROM inside the image
+static void parse_image(Rom &rom) {
+    if (rom.size < sizeof(NesHdr) ||
+        std::memcmp(rom.data, NES_NAME, sizeof(NES_NAME)) != 0) {
+        throw std::runtime_error("Failed to read header");
+    }
+    std::memcpy(&rom.header, rom.data, sizeof(NesHdr));
+
+    // If a "trainer" exists we just need to skip it before we get to the good
+    // stuff
+    size_t offset = sizeof(NesHdr) + (rom.header.trainer ? 512 : 0);
+
+    rom.prg_size = MAX(1, rom.header.n_chunk_prg) * 16 * 1024; // 16kb chunks
+    rom.chr_size = rom.header.n_chunk_chr * 8 * 1024;          // 8kb chunks
+
+    if (offset + rom.prg_size > rom.size)
+        throw std::runtime_error("Failed to read prg rom");
+    rom.prg = rom.data + offset;
+    offset += rom.prg_size;
+
+    if (offset + rom.chr_size > rom.size)
+        throw std::runtime_error("Failed to read chr rom");
+    rom.chr = rom.chr_size ? rom.data + offset : nullptr;
+}
+
+// Decode the tiles of CHR-ROM, see `Disk::ReadTileRow`
+static void decode_chr(Rom &rom) {
+    rom.tiles.resize(rom.chr_size * 4);
+    for (uint32_t i = 0; i < rom.chr_size / 16; i++)
+        Chr::decode_tile(rom.chr + i * 16, rom.tiles.data() + i * 64);
+}
+
+// ----------------------------------------------------------------------------
+// Rom Class
+// ----------------------------------------------------------------------------
+
+// Constructor
+Rom::Rom() {
+    prg = chr = data = nullptr;
+    prg_size = chr_size = 0;
+    hash = 0;
+    size = 0;
+    mapped = false;
+}
+
+// Destructor
+Rom::~Rom() {
+#if ROM_MMAP
+    if (mapped)
+        munmap((void *)data, size);
+#endif
+}
+
+// Load a ROM image.
+//
+// The image is mapped read-only and hashed; if a ROM with the same contents is
+// loaded already, that one is returned and the new mapping dropped, so that
+// all the instances of a game share one copy of it. On a hash collision the
+// new ROM replaces the other one in the cache, which stays alive as long as it
+// is in use.
+std::shared_ptr<const Rom> Rom::Load(const std::string &path) {
+    auto rom = std::make_shared<Rom>();
+    map_image(path, *rom);
+    rom->hash = hash_image(rom->data, rom->size);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = cache.find(rom->hash);
+    if (it != cache.end()) {
+        // a matching hash only tells the images apart, it does not prove them
+        // equal
+        std::shared_ptr<const Rom> hit = it->second.lock();
+        if (hit && hit->size == rom->size &&
+            std::memcmp(hit->data, rom->data, rom->size) == 0) {
+            return hit;
+        }
+    }
+
+    parse_image(*rom);
+    decode_chr(*rom);
+
+    // drop the entries of ROMs not in use anymore
+    std::erase_if(cache, [](const auto &kv) { return kv.second.expired(); });
+    cache[rom->hash] = rom;
+    return rom;
+}
@@ -0,0 +1,202 @@
+#include "nes.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// ----------------------------------------------------------------------------
+// Savestates
+//
+// Save and Load copy the same fields, in the same order: keep them in sync,
+// and bump `SaveState::kVersion` along with any change of the layout.
+// ----------------------------------------------------------------------------
+
+// The sizes of the structs the fields are copied from, so that adding a field
+// to any of them breaks the build until it is either copied here as well, or
+// left out on purpose (see savestate.hpp); and the layout of the state along
+// with its version. The sizes are those of 64-bit builds with libstdc++.
+#if defined(__GLIBCXX__) && UINTPTR_MAX == UINT64_MAX
+static_assert(sizeof(CPU) == 144, "CPU changed: update the savestate");
+static_assert(sizeof(PPU) == 246208, "PPU changed: update the savestate");
+static_assert(sizeof(Disk) == 11264, "Disk changed: update the savestate");
+static_assert(sizeof(Mapper) == 21, "Mapper changed: update the savestate");
+static_assert(sizeof(NES) == 246464, "NES changed: update the savestate");
+static_assert(sizeof(SaveState) == 23424 && SaveState::kVersion == 1,
+              "savestate layout changed: bump SaveState::kVersion");
+#endif
+
+// The cartridge RAM at the front of `Disk::banks`, the decoded tiles of
+// CHR-RAM left out
+static size_t cart_ram_size(const Disk &disk) {
+    return disk.chr_ram ? SaveState::kCartRAMSize : 0x2000;
+}
+
+void NES::Save(SaveState &state) const {
+    if (!disk->rom)
+        throw std::runtime_error("No cartridge attached");
+
+    state.magic = SaveState::kMagic;
+    state.version = SaveState::kVersion;
+    state.rom = disk->rom->hash;
+
+    // CPU
+    state.cpu.PC = cpu.PC;
+    state.cpu.RF = cpu.RF;
+    state.cpu.LF = cpu.LF;
+    state.cpu.RA = cpu.RA;
+    state.cpu.RX = cpu.RX;
+    state.cpu.RY = cpu.RY;
+    state.cpu.SP = cpu.SP;
+    state.cpu.cycles = cpu.cycles;
+    state.cpu.TABS = cpu.TABS;
+    state.cpu.TREL = cpu.TREL;
+    state.cpu.TDAT = cpu.TDAT;
+    state.cpu.cyc_count = cpu.cyc_count;
+    state.cpu.addr = cpu.addr;
+    state.cpu.opcode = cpu.opcode;
+    state.cpu.mode = cpu.mode;
+    state.cpu.instr = cpu.instr;
+    state.cpu.n_param = cpu.n_param;
+    state.cpu.lhs = cpu.lhs;
+    state.cpu.rhs = cpu.rhs;
+
+    // PPU
+    std::memcpy(state.ppu.fg_line, ppu.fg_line, sizeof(ppu.fg_line));
+    state.ppu.fg_count = ppu.fg_count;
+    state.ppu.scanline = ppu.scanline;
+    state.ppu.cycle = ppu.cycle;
+    state.ppu.clock = ppu.clock;
+    state.ppu.bg_shift_pat_lo = ppu.bg_shift_pat_lo;
+    state.ppu.bg_shift_pat_hi = ppu.bg_shift_pat_hi;
+    state.ppu.bg_shift_attr_lo = ppu.bg_shift_attr_lo;
+    state.ppu.bg_shift_attr_hi = ppu.bg_shift_attr_hi;
+    state.ppu.bg_tile_id = ppu.bg_tile_id;
+    state.ppu.bg_tile_attr = ppu.bg_tile_attr;
+    state.ppu.bg_tile_lo = ppu.bg_tile_lo;
+    state.ppu.bg_tile_hi = ppu.bg_tile_hi;
+    state.ppu.nmi = ppu.nmi;
+    state.ppu.frame_complete = ppu.frame_complete;
+    state.ppu.odd_frame = ppu.odd_frame;
+
+    // Disk
+    std::memcpy(state.disk.ram, disk->ram, sizeof(disk->ram));
+    std::memcpy(state.disk.vrm, disk->vrm, sizeof(disk->vrm));
+    std::memcpy(state.disk.pal, disk->pal, sizeof(disk->pal));
+    state.disk.oam = disk->oam;
+    std::memcpy(state.disk.cart, disk->banks.data(), cart_ram_size(*disk));
+    state.disk.pram = disk->pram;
+    state.disk.oam_dma = disk->oam_dma;
+    state.disk.mirror = disk->mirror;
+    for (uint8_t i = 0; i < 4; i++)
+        state.disk.prg_bank[i] =
+            (disk->page_rd[0x80 + i * 0x20] - disk->prg) / 0x2000;
+    for (uint8_t i = 0; i < 8; i++)
+        state.disk.chr_bank[i] = (disk->chr_rd[i] - disk->chr) / 0x0400;
+
+    // Mapper
+    const Mapper &mapper = disk->mapper;
+    state.mapper.shift = mapper.shift;
+    state.mapper.n_shift = mapper.n_shift;
+    state.mapper.control = mapper.control;
+    state.mapper.chr0 = mapper.chr0;
+    state.mapper.chr1 = mapper.chr1;
+    state.mapper.prg = mapper.prg;
+    state.mapper.select = mapper.select;
+    std::memcpy(state.mapper.bank, mapper.bank, sizeof(mapper.bank));
+    state.mapper.irq_latch = mapper.irq_latch;
+    state.mapper.irq_counter = mapper.irq_counter;
+    state.mapper.irq_reload = mapper.irq_reload;
+    state.mapper.irq_enable = mapper.irq_enable;
+    state.mapper.irq = mapper.irq;
+
+    // Scheduler
+    state.clock_base = clock_base;
+}
+
+void NES::Load(const SaveState &state) {
+    if (state.magic != SaveState::kMagic)
+        throw std::runtime_error("Not a savestate");
+    if (state.version != SaveState::kVersion)
+        throw std::runtime_error("Unsupported savestate version: " +
+                                 std::to_string(state.version));
+    if (!disk->rom || state.rom != disk->rom->hash)
+        throw std::runtime_error("Savestate of another cartridge");
+
+    // CPU
+    cpu.PC = state.cpu.PC;
+    cpu.RF = state.cpu.RF;
+    cpu.LF = state.cpu.LF;
+    cpu.RA = state.cpu.RA;
+    cpu.RX = state.cpu.RX;
+    cpu.RY = state.cpu.RY;
+    cpu.SP = state.cpu.SP;
+    cpu.cycles = state.cpu.cycles;
+    cpu.TABS = state.cpu.TABS;
+    cpu.TREL = state.cpu.TREL;
+    cpu.TDAT = state.cpu.TDAT;
+    cpu.cyc_count = state.cpu.cyc_count;
+    cpu.addr = state.cpu.addr;
+    cpu.opcode = state.cpu.opcode;
+    cpu.mode = state.cpu.mode;
+    cpu.instr = state.cpu.instr;
+    cpu.n_param = state.cpu.n_param;
+    cpu.lhs = state.cpu.lhs;
+    cpu.rhs = state.cpu.rhs;
+
+    // PPU
+    std::memcpy(ppu.fg_line, state.ppu.fg_line, sizeof(ppu.fg_line));
+    ppu.fg_count = state.ppu.fg_count;
+    ppu.scanline = state.ppu.scanline;
+    ppu.cycle = state.ppu.cycle;
+    ppu.clock = state.ppu.clock;
+    ppu.bg_shift_pat_lo = state.ppu.bg_shift_pat_lo;
+    ppu.bg_shift_pat_hi = state.ppu.bg_shift_pat_hi;
+    ppu.bg_shift_attr_lo = state.ppu.bg_shift_attr_lo;
+    ppu.bg_shift_attr_hi = state.ppu.bg_shift_attr_hi;
+    ppu.bg_tile_id = state.ppu.bg_tile_id;
+    ppu.bg_tile_attr = state.ppu.bg_tile_attr;
+    ppu.bg_tile_lo = state.ppu.bg_tile_lo;
+    ppu.bg_tile_hi = state.ppu.bg_tile_hi;
+    ppu.nmi = state.ppu.nmi;
+    ppu.frame_complete = state.ppu.frame_complete;
+    ppu.odd_frame = state.ppu.odd_frame;
+
+    // Disk
+    std::memcpy(disk->ram, state.disk.ram, sizeof(disk->ram));
+    std::memcpy(disk->vrm, state.disk.vrm, sizeof(disk->vrm));
+    std::memcpy(disk->pal, state.disk.pal, sizeof(disk->pal));
+    disk->oam = state.disk.oam;
+    std::memcpy(disk->banks.data(), state.disk.cart, cart_ram_size(*disk));
+    disk->pram = state.disk.pram;
+    disk->oam_dma = state.disk.oam_dma;
+
+    // Mapper
+    Mapper &mapper = disk->mapper;
+    mapper.shift = state.mapper.shift;
+    mapper.n_shift = state.mapper.n_shift;
+    mapper.control = state.mapper.control;
+    mapper.chr0 = state.mapper.chr0;
+    mapper.chr1 = state.mapper.chr1;
+    mapper.prg = state.mapper.prg;
+    mapper.select = state.mapper.select;
+    std::memcpy(mapper.bank, state.mapper.bank, sizeof(mapper.bank));
+    mapper.irq_latch = state.mapper.irq_latch;
+    mapper.irq_counter = state.mapper.irq_counter;
+    mapper.irq_reload = state.mapper.irq_reload;
+    mapper.irq_enable = state.mapper.irq_enable;
+    mapper.irq = state.mapper.irq;
+
+    // Scheduler
+    clock_base = state.clock_base;
+
+    // Re-link: mirrors and banks as of the state. The contents of CHR-RAM
+    // changed in place, and so did the palette.
+    disk->MapNT(state.disk.mirror);
+    for (uint8_t i = 0; i < 4; i++)
+        disk->MapPRG(i, state.disk.prg_bank[i]);
+    for (uint8_t i = 0; i < 8; i++)
+        disk->MapCHR(i, state.disk.chr_bank[i]);
+    if (disk->tile_ok)
+        std::fill_n(disk->tile_ok, 0x0200, false);
+    disk->pal_dirty = true;
+}
@@ -1,14 +1,26 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "chr.hpp"
 #include "cpu.hpp"
+#include "nes.hpp"
+#include "pacer.hpp"
+#include "rewind.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
 
-// Test CPU by running nestest.nes and comparing the registers and cycles.
+// Test CPU by running nestest.nes and comparing the registers and cycles,
+// running each instruction through `step`.
 //
 // Log Reference: https://www.qmtpro.com/~nes/misc/nestest.log
 //
 // Note: currently only covers the top ~5000 instructions as the program
 //       contains many illegal opcodes that are not implemented
-TEST(CPUTest, NesLogCompare) {
+static void nes_log_compare(void (*step)(CPU &)) {
 
     CPU cpu = CPU();
 
@@ -19,25 +31,623 @@ TEST(CPUTest, NesLogCompare) {
     cpu.Reset();
     // align with nestest.log
     cpu.PC = 0xC000;
-    cpu.RF.reg = 0b00100100;
+    cpu.LoadF(0b00100100);
     cpu.cycles = 7;
 
     int limit = 5250;
 
     for (int i = 0; i < limit; i++) {
-        cpu.Read();
-        // cpu.Print(); // print ALL logs
-        cpu.RunInstr();
+        step(cpu);
     }
 
     EXPECT_EQ(cpu.RA, 0x32);
     EXPECT_EQ(cpu.RX, 0x00);
     EXPECT_EQ(cpu.RY, 0x58);
-    EXPECT_EQ(cpu.RF.reg, 0x25);
+    EXPECT_EQ(cpu.SyncF().reg, 0x25);
     EXPECT_EQ(cpu.SP, 0xFB);
     EXPECT_EQ(cpu.cyc_count, 15252);
 }
 
+TEST(CPUTest, NesLogCompare) {
+    nes_log_compare([](CPU &cpu) {
+        cpu.Read();
+        // cpu.Print(); // print ALL logs
+        cpu.RunInstr();
+    });
+}
+
+// Same as above, but through the fused opcode handlers.
+TEST(CPUTest, NesLogCompareStep) {
+    nes_log_compare([](CPU &cpu) { cpu.Step(); });
+}
+
+// Running whole blocks must end up in the same state as single steps, at the
+// end of every block.
+TEST(CPUTest, BlockMatchesStep) {
+
+    CPU ref = CPU();
+    CPU cpu = CPU();
+
+    Disk ref_disk = Disk();
+    Disk disk = Disk();
+    ref.Mount(ref_disk);
+    cpu.Mount(disk);
+    ref_disk.Attach("./data/nestest.nes");
+    disk.Attach("./data/nestest.nes");
+
+    for (CPU *c : {&ref, &cpu}) {
+        c->Reset();
+        c->PC = 0xC000;
+        c->LoadF(0b00100100);
+        c->cycles = 7;
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        cpu.RunBlock();
+        while (ref.cyc_count + ref.cycles < cpu.cyc_count + cpu.cycles) {
+            ref.Step();
+        }
+        ASSERT_EQ(ref.cyc_count + ref.cycles, cpu.cyc_count + cpu.cycles);
+        ASSERT_EQ(ref.PC, cpu.PC);
+        ASSERT_EQ(ref.RA, cpu.RA);
+        ASSERT_EQ(ref.RX, cpu.RX);
+        ASSERT_EQ(ref.RY, cpu.RY);
+        ASSERT_EQ(ref.SyncF().reg, cpu.SyncF().reg);
+        ASSERT_EQ(ref.SP, cpu.SP);
+    }
+}
+
+// A block with a budget of one cycle runs a single instruction, like `Step`.
+TEST(CPUTest, BlockBudget) {
+
+    CPU ref = CPU();
+    CPU cpu = CPU();
+
+    Disk ref_disk = Disk();
+    Disk disk = Disk();
+    ref.Mount(ref_disk);
+    cpu.Mount(disk);
+    ref_disk.Attach("./data/nestest.nes");
+    disk.Attach("./data/nestest.nes");
+
+    for (CPU *c : {&ref, &cpu}) {
+        c->Reset();
+        c->PC = 0xC000;
+        c->LoadF(0b00100100);
+        c->cycles = 7;
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        cpu.RunBlock(1);
+        ref.Step();
+        ASSERT_EQ(ref.cyc_count, cpu.cyc_count);
+        ASSERT_EQ(ref.cycles, cpu.cycles);
+        ASSERT_EQ(ref.PC, cpu.PC);
+        ASSERT_EQ(ref.RA, cpu.RA);
+    }
+}
+
+// Disks attaching the same ROM share one read-only copy of it, while their
+// RAM stays separate.
+TEST(DiskTest, RomShared) {
+
+    Disk a = Disk();
+    Disk b = Disk();
+    a.Attach("./data/nestest.nes");
+    b.Attach("./data/nestest.nes");
+
+    EXPECT_EQ(a.rom, b.rom);
+    EXPECT_EQ(a.ReadMBus(0xC000), b.ReadMBus(0xC000));
+
+    // CHR-ROM ignores writes
+    const Byte chr = a.ReadPBus(0x0000);
+    a.WritePBus(0x0000, ~chr);
+    EXPECT_EQ(a.ReadPBus(0x0000), chr);
+
+    // PRG-RAM is per instance
+    a.WriteMBus(0x6000, 0x12);
+    b.WriteMBus(0x6000, 0x34);
+    EXPECT_EQ(a.ReadMBus(0x6000), 0x12);
+    EXPECT_EQ(b.ReadMBus(0x6000), 0x34);
+}
+
+// Write an iNES image with `n_prg` 16KB PRG-ROM banks, each 8KB half filled
+// with its 8KB bank number, and CHR-RAM.
+static std::string write_rom(const std::string &name, const uint8_t &mapper,
+                             const uint8_t &n_prg) {
+    const std::string path = testing::TempDir() + name;
+    std::ofstream file(path, std::ios::binary);
+    const char header[16] = {0x4E, 0x45, 0x53, 0x1A, (char)n_prg, 0,
+                             (char)((mapper & 0x0F) << 4), (char)(mapper & 0xF0)};
+    file.write(header, sizeof(header));
+    for (int i = 0; i < n_prg * 2; i++) {
+        const std::string bank(0x2000, (char)i);
+        file.write(bank.data(), bank.size());
+    }
+    return path;
+}
+
+// Write an NROM image with `code` at 0x8000, mirrored at 0xC000, and `chr`
+// as CHR-ROM (CHR-RAM if empty)
+static std::string write_prg(const std::string &name,
+                             const std::vector<Byte> &code,
+                             const std::vector<Byte> &chr = {}) {
+    const std::string path = testing::TempDir() + name;
+    std::ofstream file(path, std::ios::binary);
+    const char header[16] = {0x4E, 0x45, 0x53, 0x1A, 1, (char)!chr.empty()};
+    file.write(header, sizeof(header));
+    std::string prg(0x4000, (char)0xEA); // NOP
+    std::copy(code.begin(), code.end(), prg.begin());
+    // NMI vector: 0x8100; reset vector: 0x8000
+    prg[0x3FFA] = 0x00;
+    prg[0x3FFB] = (char)0x81;
+    prg[0x3FFC] = 0x00;
+    prg[0x3FFD] = (char)0x80;
+    file.write(prg.data(), prg.size());
+    file.write((const char *)chr.data(), chr.size());
+    return path;
+}
+
+// Loops polling PPUSTATUS are only idle when waiting for vblank (bit 7):
+// sprite 0 hit and overflow are not events of the scheduler.
+TEST(CPUTest, IdleStatusPoll) {
+
+    CPU cpu = CPU();
+    Disk disk = Disk();
+    cpu.Mount(disk);
+    disk.Attach(write_prg("poll.nes", {
+                                          // 0x8000: sprite 0 hit
+                                          0xAD, 0x02, 0x20, // LDA $2002
+                                          0x29, 0x40,       // AND #$40
+                                          0xF0, 0xF9,       // BEQ 0x8000
+                                          // 0x8007: vblank
+                                          0x2C, 0x02, 0x20, // BIT $2002
+                                          0x10, 0xFB,       // BPL 0x8007
+                                          // 0x800C: vblank, then Z
+                                          0xAD, 0x02, 0x20, // LDA $2002
+                                          0xF0, 0xFB,       // BEQ 0x800C
+                                      }));
+    cpu.Reset();
+
+    // (start, instructions per iteration, cycles per iteration if idle)
+    const uint16_t loops[3][3] = {{0x8000, 3, 0}, {0x8007, 2, 7}, {0x800C, 2, 0}};
+    for (const auto &loop : loops) {
+        cpu.PC = loop[0];
+        disk.pram.status.reg = 0;
+        for (int i = 0; i < loop[1]; i++)
+            cpu.Step();
+        ASSERT_EQ(cpu.PC, loop[0]);
+        EXPECT_EQ(cpu.IdleCycles(), loop[2]);
+    }
+}
+
+// Bank switches repoint the PRG window and invalidate what the CPU derived
+// from the old contents.
+TEST(DiskTest, MapperBankSwitch) {
+
+    // UxROM: 16KB switchable at 0x8000, last 16KB fixed at 0xC000
+    Disk uxrom = Disk();
+    uxrom.Attach(write_rom("uxrom.nes", 2, 4));
+    EXPECT_EQ(uxrom.ReadMBus(0x8000), 0);
+    EXPECT_EQ(uxrom.ReadMBus(0xC000), 6);
+    EXPECT_EQ(uxrom.ReadMBus(0xE000), 7);
+
+    const uint32_t rev = uxrom.prg_rev[0];
+    uxrom.WriteMBus(0x8000, 2);
+    EXPECT_EQ(uxrom.ReadMBus(0x8000), 4);
+    EXPECT_EQ(uxrom.ReadMBus(0xA000), 5);
+    EXPECT_EQ(uxrom.ReadMBus(0xC000), 6);
+    EXPECT_NE(uxrom.prg_rev[0], rev);
+
+    // CHR-RAM is writable
+    uxrom.WritePBus(0x1234, 0x56);
+    EXPECT_EQ(uxrom.ReadPBus(0x1234), 0x56);
+
+    // MMC1: the PRG bank register (0xE000) is written 1 bit at a time
+    Disk mmc1 = Disk();
+    mmc1.Attach(write_rom("mmc1.nes", 1, 8));
+    EXPECT_EQ(mmc1.ReadMBus(0x8000), 0);
+    EXPECT_EQ(mmc1.ReadMBus(0xC000), 14);
+    for (int i = 0; i < 5; i++)
+        mmc1.WriteMBus(0xE000, 3 >> i);
+    EXPECT_EQ(mmc1.ReadMBus(0x8000), 6);
+    EXPECT_EQ(mmc1.ReadMBus(0xC000), 14);
+}
+
+// Decoded tiles follow the writes to CHR-RAM and the CHR bank switches.
+TEST(DiskTest, TileCache) {
+
+    Disk disk = Disk();
+    disk.Attach(write_rom("mmc1_chr.nes", 1, 2));
+
+    const Byte row[8] = {0, 1, 3, 2, 0, 0, 0, 2};
+    disk.WritePBus(0x1003, 0x60); // low bit plane
+    disk.WritePBus(0x100B, 0x31); // high bit plane
+    EXPECT_EQ(0, memcmp(disk.ReadTileRow(0x1003), row, 8));
+
+    disk.WritePBus(0x1003, 0x00);
+    EXPECT_EQ(disk.ReadTileRow(0x1003)[1], 0);
+    EXPECT_EQ(disk.ReadTileRow(0x1003)[2], 2);
+
+    // 4KB CHR mode, both halves on the 2nd 4KB bank
+    EXPECT_EQ(disk.ReadTileRow(0x0003)[2], 0);
+    for (int i = 0; i < 5; i++)
+        disk.WriteMBus(0x8000, 0x10 >> i);
+    for (int i = 0; i < 5; i++)
+        disk.WriteMBus(0xA000, 1 >> i);
+    for (int i = 0; i < 5; i++)
+        disk.WriteMBus(0xC000, 1 >> i);
+    EXPECT_EQ(disk.ReadTileRow(0x0003)[2], 2);
+
+    // a write through either half shows in both
+    disk.WritePBus(0x0003, 0xFF);
+    EXPECT_EQ(disk.ReadTileRow(0x1003)[0], 1);
+}
+
+// CHR-ROM is decoded once, for all the disks attaching the ROM.
+TEST(DiskTest, TileRom) {
+
+    Disk a = Disk();
+    Disk b = Disk();
+    a.Attach("./data/nestest.nes");
+    b.Attach("./data/nestest.nes");
+
+    for (uint16_t addr = 0; addr < 0x2000; addr += 0x10) {
+        const Byte *row = a.ReadTileRow(addr + 5);
+        Byte px[64];
+        Chr::decode_tile_bits(a.rom->chr + addr, px);
+        ASSERT_EQ(0, memcmp(row, px + 5 * 8, 8));
+        ASSERT_EQ(row, b.ReadTileRow(addr + 5));
+    }
+}
+
+// OAMADDR / OAMDATA address the sprites byte by byte, each byte landing in
+// its own array.
+TEST(DiskTest, OAM) {
+
+    Disk disk = Disk();
+    disk.Attach("./data/nestest.nes");
+
+    disk.WriteMBus(0x2003, 0x08); // sprite 2
+    const Byte sprite[4] = {0x10, 0x20, 0xFF, 0x30};
+    for (const Byte &data : sprite)
+        disk.WriteMBus(0x2004, data);
+    EXPECT_EQ(disk.pram.oamaddr, 0x0C);
+    EXPECT_EQ(disk.oam.y[2], 0x10);
+    EXPECT_EQ(disk.oam.tile[2], 0x20);
+    EXPECT_EQ(disk.oam.attr[2], 0xE3); // bits 2 - 4 do not exist
+    EXPECT_EQ(disk.oam.x[2], 0x30);
+
+    // reads do not increment the address
+    disk.WriteMBus(0x2003, 0x0B);
+    EXPECT_EQ(disk.ReadMBus(0x2004), 0x30);
+    EXPECT_EQ(disk.ReadMBus(0x2004), 0x30);
+}
+
+// OAM DMA copies a whole page at once, starting at OAMADDR.
+TEST(DiskTest, OAMDMA) {
+
+    Disk disk = Disk();
+    disk.Attach("./data/nestest.nes");
+
+    for (int i = 0; i < 256; i++)
+        disk.WriteMBus(0x0200 + i, i);
+    disk.WriteMBus(0x2003, 0x04);
+    disk.WriteMBus(0x4014, 0x02);
+
+    EXPECT_TRUE(disk.oam_dma);
+    EXPECT_EQ(disk.oam.y[1], 0x00);
+    EXPECT_EQ(disk.oam.x[1], 0x03);
+    EXPECT_EQ(disk.oam.y[0], 0xFC); // wrapped around
+    EXPECT_EQ(disk.oam.attr[63], 0xFA & 0xE3);
+}
+
+// The MMC3 IRQ fires after the predicted number of scanline clocks.
+TEST(DiskTest, MapperIRQ) {
+
+    Disk disk = Disk();
+    disk.Attach(write_rom("mmc3.nes", 4, 8));
+
+    disk.WriteMBus(0xC000, 3); // latch
+    disk.WriteMBus(0xC001, 0); // reload
+    disk.WriteMBus(0xE001, 0); // enable
+    ASSERT_EQ(disk.mapper.ScanlinesToIRQ(), 4);
+
+    for (int i = 0; i < 3; i++) {
+        disk.mapper.Scanline();
+        EXPECT_FALSE(disk.mapper.irq);
+    }
+    disk.mapper.Scanline();
+    EXPECT_TRUE(disk.mapper.irq);
+
+    // acknowledge
+    disk.WriteMBus(0xE000, 0);
+    EXPECT_FALSE(disk.mapper.irq);
+    EXPECT_EQ(disk.mapper.ScanlinesToIRQ(), 0);
+}
+
+// Rendering the visible lines a whole line at once draws the same frames, and
+// leaves the PPU registers in the same state, as rendering them dot by dot.
+//
+// The program scrolls by a few pixels more every frame (fine X / Y), splits
+// the screen with another horizontal scroll, nametable and 8x16 sprites
+// halfway down, and cycles through the 4 settings of the left column masks.
+// Nametables, attributes, palettes and the sprites (DMA'ed straight from
+// PRG-ROM) are all filled with random data.
+TEST(PPUTest, LinesMatchDots) {
+
+    std::vector<Byte> code(0x1000, 0xEA); // NOP
+    const std::vector<Byte> reset = {
+        0x78,             // SEI
+        0xD8,             // CLD
+        0xA2, 0xFF,       // LDX #$FF
+        0x9A,             // TXS
+        0xA9, 0x00,       // LDA #0
+        0x8D, 0x00, 0x20, // STA $2000
+        0x8D, 0x01, 0x20, // STA $2001
+        // 0x800D: wait for the PPU to warm up
+        0x2C, 0x02, 0x20, // BIT $2002
+        0x10, 0xFB,       // BPL 0x800D
+        0x2C, 0x02, 0x20, // BIT $2002
+        0x10, 0xFB,       // BPL 0x8012
+        // 0x8017: palettes from 0x8800
+        0xA9, 0x3F,       // LDA #$3F
+        0x8D, 0x06, 0x20, // STA $2006
+        0xA9, 0x00,       // LDA #0
+        0x8D, 0x06, 0x20, // STA $2006
+        0xA2, 0x00,       // LDX #0
+        0xBD, 0x00, 0x88, // LDA $8800,X
+        0x8D, 0x07, 0x20, // STA $2007
+        0xE8,             // INX
+        0xE0, 0x20,       // CPX #32
+        0xD0, 0xF5,       // BNE 0x8023
+        // 0x802E: both nametables from 0x8800 - 0x8FFF
+        0xA9, 0x20,       // LDA #$20
+        0x8D, 0x06, 0x20, // STA $2006
+        0xA9, 0x00,       // LDA #0
+        0x8D, 0x06, 0x20, // STA $2006
+        0x85, 0x00,       // STA $00
+        0xA9, 0x88,       // LDA #$88
+        0x85, 0x01,       // STA $01
+        0xA2, 0x08,       // LDX #8
+        0xA0, 0x00,       // LDY #0
+        0xB1, 0x00,       // LDA ($00),Y
+        0x8D, 0x07, 0x20, // STA $2007
+        0xC8,             // INY
+        0xD0, 0xF8,       // BNE 0x8042
+        0xE6, 0x01,       // INC $01
+        0xCA,             // DEX
+        0xD0, 0xF3,       // BNE 0x8042
+        // 0x804F: NMI on, sprites at 0x1000, rendering on
+        0xA9, 0x88,       // LDA #$88
+        0x8D, 0x00, 0x20, // STA $2000
+        0xA9, 0x1E,       // LDA #$1E
+        0x8D, 0x01, 0x20, // STA $2001
+        // 0x8059: wait for the NMI, then for ~90 lines
+        0xA5, 0x03,       // LDA $03
+        0xF0, 0xFC,       // BEQ 0x8059
+        0xA9, 0x00,       // LDA #0
+        0x85, 0x03,       // STA $03
+        0xA2, 0x0A,       // LDX #10
+        0xA0, 0xFF,       // LDY #$FF
+        0x88,             // DEY
+        0xD0, 0xFD,       // BNE 0x8065
+        0xCA,             // DEX
+        0xD0, 0xF8,       // BNE 0x8063
+        // 0x806B: split
+        0xA5, 0x02,       // LDA $02
+        0x0A,             // ASL A
+        0x69, 0x03,       // ADC #3
+        0x8D, 0x05, 0x20, // STA $2005
+        0x8D, 0x05, 0x20, // STA $2005
+        0xA5, 0x02,       // LDA $02
+        0x29, 0x01,       // AND #1
+        0x09, 0xA8,       // ORA #$A8
+        0x8D, 0x00, 0x20, // STA $2000
+        0x4C, 0x59, 0x80, // JMP 0x8059
+    };
+    const std::vector<Byte> nmi = {
+        // 0x8100: sprites from one of the pages 0x88 - 0x8F
+        0x48,             // PHA
+        0xA5, 0x02,       // LDA $02
+        0x29, 0x07,       // AND #7
+        0x09, 0x88,       // ORA #$88
+        0x8D, 0x14, 0x40, // STA $4014
+        // 0x810A: scroll, masks and nametable of the frame
+        0xE6, 0x02,       // INC $02
+        0xA5, 0x02,       // LDA $02
+        0x8D, 0x05, 0x20, // STA $2005
+        0x4A,             // LSR A
+        0x8D, 0x05, 0x20, // STA $2005
+        0xA5, 0x02,       // LDA $02
+        0x29, 0x06,       // AND #6
+        0x49, 0x1E,       // EOR #$1E
+        0x8D, 0x01, 0x20, // STA $2001
+        0xA5, 0x02,       // LDA $02
+        0x29, 0x01,       // AND #1
+        0x09, 0x88,       // ORA #$88
+        0x8D, 0x00, 0x20, // STA $2000
+        0xA9, 0x01,       // LDA #1
+        0x85, 0x03,       // STA $03
+        0x68,             // PLA
+        0x40,             // RTI
+    };
+    std::copy(reset.begin(), reset.end(), code.begin());
+    std::copy(nmi.begin(), nmi.end(), code.begin() + 0x100);
+
+    // random data at 0x8800 - 0x8FFF, and patterns
+    uint32_t seed = 1;
+    const auto random = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return (Byte)(seed >> 16);
+    };
+    std::generate(code.begin() + 0x800, code.end(), random);
+    for (int i = 0; i < 32; i++)
+        code[0x800 + i] &= 0x3F;
+    std::vector<Byte> chr(0x2000);
+    std::generate(chr.begin(), chr.end(), random);
+    const std::string path = write_prg("lines.nes", code, chr);
+
+    auto lines = std::make_unique<NES>();
+    auto dots = std::make_unique<NES>();
+    lines->Load(path);
+    dots->Load(path);
+    dots->ppu.lines = false;
+    for (int i = 0; i < 30; i++) {
+        lines->RunFrame();
+        dots->RunFrame();
+        ASSERT_EQ(std::memcmp(lines->ppu.frame, dots->ppu.frame,
+                              sizeof(lines->ppu.frame)),
+                  0)
+            << "frame " << i;
+        ASSERT_EQ(std::memcmp(&lines->disk->pram, &dots->disk->pram,
+                              sizeof(PMem)),
+                  0)
+            << "frame " << i;
+    }
+    // the NMI ran on (almost) every frame
+    EXPECT_GT(lines->disk->ram[0x02], 20);
+}
+
+// The reader of a triple buffer only ever sees whole values, newer and newer.
+TEST(SyncTest, TripleBuffer) {
+
+    struct Value {
+        uint32_t n[256];
+    };
+    TripleBuffer<Value> buffer;
+    constexpr uint32_t kValues = 100000;
+
+    std::thread writer([&buffer]() {
+        for (uint32_t i = 1; i <= kValues; i++) {
+            std::fill(std::begin(buffer.Back().n), std::end(buffer.Back().n), i);
+            buffer.Publish();
+        }
+    });
+
+    uint32_t last = 0;
+    while (last < kValues) {
+        if (!buffer.Fetch())
+            continue;
+        const Value &value = buffer.Front();
+        ASSERT_GT(value.n[0], last);
+        ASSERT_EQ(value.n[0], value.n[255]);
+        last = value.n[0];
+    }
+    writer.join();
+    EXPECT_FALSE(buffer.Fetch());
+}
+
+// A SPSC queue hands over every item, in order, and refuses them when full.
+TEST(SyncTest, SpscQueue) {
+
+    SpscQueue<uint32_t, 8> queue;
+    for (uint32_t i = 0; i < 8; i++)
+        EXPECT_TRUE(queue.Push(i));
+    EXPECT_FALSE(queue.Push(8));
+    uint32_t item;
+    for (uint32_t i = 0; i < 8; i++) {
+        ASSERT_TRUE(queue.Pop(item));
+        EXPECT_EQ(item, i);
+    }
+    EXPECT_FALSE(queue.Pop(item));
+
+    constexpr uint32_t kItems = 100000;
+    std::thread producer([&queue]() {
+        for (uint32_t i = 0; i < kItems; i++) {
+            while (!queue.Push(i))
+                std::this_thread::yield();
+        }
+    });
+    for (uint32_t i = 0; i < kItems; i++) {
+        while (!queue.Pop(item))
+            std::this_thread::yield();
+        ASSERT_EQ(item, i);
+    }
+    producer.join();
+}
+
+// A restored console runs the same frames as when the state was saved, and
+// states of another version are refused.
+TEST(StateTest, RoundTrip) {
+
+    auto nes = std::make_unique<NES>();
+    nes->Load("./data/nestest.nes");
+    for (int i = 0; i < 10; i++)
+        nes->RunFrame();
+
+    auto state = std::make_unique<SaveState>();
+    nes->Save(*state);
+    for (int i = 0; i < 10; i++)
+        nes->RunFrame();
+    const std::vector<uint32_t> frame(std::begin(nes->ppu.frame),
+                                      std::end(nes->ppu.frame));
+    const uint16_t pc = nes->cpu.PC;
+    const size_t cyc_count = nes->cpu.cyc_count;
+
+    nes->Load(*state);
+    for (int i = 0; i < 10; i++)
+        nes->RunFrame();
+    EXPECT_EQ(nes->cpu.PC, pc);
+    EXPECT_EQ(nes->cpu.cyc_count, cyc_count);
+    EXPECT_TRUE(std::equal(frame.begin(), frame.end(), nes->ppu.frame));
+
+    state->version++;
+    EXPECT_THROW(nes->Load(*state), std::runtime_error);
+}
+
+// Stepping back restores the snapshots, newest first, as long as the ring
+// holds them, including once it wrapped around with deltas of varied sizes
+// left over at its end.
+TEST(RewindTest, Step) {
+
+    auto nes = std::make_unique<NES>();
+    nes->Load("./data/nestest.nes");
+
+    // room for a few deltas only
+    Rewind rewind(1000, 1);
+    std::vector<SaveState> states(260);
+    for (size_t i = 0; i < states.size(); i++) {
+        nes->RunFrame();
+        // change more or less of the (unused) RAM, for deltas of varied sizes
+        for (size_t k = 0; k < (i * 7) % 97; k++)
+            nes->disk->ram[0x0400 + (i * 13 + k * 5) % 0x0300] = i + k;
+        rewind.Push(*nes);
+        nes->Save(states[i]);
+    }
+    EXPECT_EQ(rewind.pushed, states.size());
+    EXPECT_LE(rewind.Used(), 1000);
+    const size_t count = rewind.Count();
+    ASSERT_GT(count, 1);
+    ASSERT_LT(count, states.size());
+
+    auto state = std::make_unique<SaveState>();
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_TRUE(rewind.Step(*nes));
+        nes->Save(*state);
+        const SaveState &expected = states[states.size() - 1 - i];
+        ASSERT_EQ(state->cpu.cyc_count, expected.cpu.cyc_count);
+        ASSERT_EQ(state->ppu.clock, expected.ppu.clock);
+        ASSERT_EQ(std::memcmp(&state->disk, &expected.disk, sizeof(state->disk)),
+                  0);
+    }
+    EXPECT_FALSE(rewind.Step(*nes));
+}
+
+// The paced modes never run frames ahead of time. Only the lower bound holds
+// on a loaded machine: a frame may always end up late.
+TEST(PacerTest, Fixed) {
+
+    Pacer pacer;
+    const auto t0 = std::chrono::steady_clock::now();
+    pacer.Set(PaceMode::FIXED, 8.0);
+    for (int i = 0; i < 16; i++)
+        pacer.Wait();
+    // 1/8 of the NTSC frame period (16639263 ns), truncated as by the pacer
+    EXPECT_GE(std::chrono::steady_clock::now() - t0,
+              16 * std::chrono::nanoseconds(16639263 / 8));
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();